@@ -0,0 +1,70 @@
+#ifndef __MEMORY_TOOLS_ADDRESS_MAP_HH__
+#define __MEMORY_TOOLS_ADDRESS_MAP_HH__
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace memory_tools {
+
+/**
+ * @brief Constant-time "is this address mapped" lookup
+ *
+ * @details A radix tree with a fixed shape. The root is indexed by 1 GiB
+ * granule and points to a directory of 2 MiB blocks. Each block entry points
+ * to a bitmap with one bit per page. Two shared bitmaps are reserved: one
+ * for blocks that are entirely unmapped and one for blocks that are entirely
+ * mapped. Directory 0 is a shared all-unmapped directory. A lookup is
+ * therefore three dependent loads and no compares.
+ *
+ * Addresses at or above 2^47 (5-level paging, vsyscall) are rare and are
+ * kept in a sorted list that is binary searched.
+ */
+class AddressMap {
+public:
+  explicit AddressMap(size_t page_size);
+
+  void Clear();
+
+  // Marks [start_addr, end_addr) as mapped. Ranges must be page aligned and
+  // added in ascending order.
+  void Add(uint64_t start_addr, uint64_t end_addr);
+
+  bool Contains(uint64_t addr) const {
+    const uint64_t root = addr >> kRootShift;
+    if (root >= root_.size()) {
+      return ContainsHigh(addr);
+    }
+    const uint32_t block =
+        directories_[root_[root] * kBlocksPerDirectory +
+                     ((addr >> kBlockShift) & (kBlocksPerDirectory - 1))];
+    const uint64_t page = (addr >> page_shift_) & (pages_per_block_ - 1);
+    return (bitmaps_[block * words_per_block_ + page / 64] >> (page % 64)) & 1;
+  }
+
+private:
+  static constexpr unsigned kRootShift = 30;  // 1 GiB per directory
+  static constexpr unsigned kBlockShift = 21; // 2 MiB per bitmap
+  static constexpr unsigned kAddressBits = 47;
+  static constexpr size_t kBlocksPerDirectory = 1ULL
+                                                << (kRootShift - kBlockShift);
+  static constexpr uint32_t kEmptyBitmap = 0;
+  static constexpr uint32_t kFullBitmap = 1;
+
+  bool ContainsHigh(uint64_t addr) const;
+  uint32_t *BlockEntry(uint64_t addr);
+
+  unsigned page_shift_;
+  uint64_t pages_per_block_;
+  size_t words_per_block_;
+  std::vector<uint32_t> root_;        // Directory index per 1 GiB, 0 = none
+  std::vector<uint32_t> directories_; // Bitmap index per 2 MiB block
+  std::vector<uint64_t> bitmaps_;     // words_per_block_ words per bitmap
+  // Mapped ranges at or above 2^47
+  std::vector<std::pair<uint64_t, uint64_t>> high_ranges_;
+};
+
+} // namespace memory_tools
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef __MEMORY_TOOLS_CGROUP_FREEZER_HH__
+#define __MEMORY_TOOLS_CGROUP_FREEZER_HH__
+
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <string>
+
+namespace memory_tools {
+
+/**
+ * @brief Stops and resumes every task of a cgroup v2 group at once
+ *
+ * @details Writing cgroup.freeze asks the kernel to stop all threads and
+ * processes of the group, including ones forked later. The group reports
+ * "frozen 1" in cgroup.events once all of them are stopped. Nothing is
+ * traced, so the tasks can still be read and written through
+ * process_vm_readv or /proc/<pid>/mem, and signals wait until the thaw.
+ * Functions return false with errno set on failure.
+ */
+class CgroupFreezer {
+public:
+  // How long Freeze waits, e.g. for tasks in uninterruptible sleep
+  static constexpr std::chrono::milliseconds kFreezeTimeout{5000};
+
+  // Creates group `name` below the caller's own cgroup v2 group and returns
+  // its directory
+  static std::optional<std::string> Create(const std::string &name);
+  // Moves the calling process into the group at `path`, e.g. between fork
+  // and exec
+  static bool Join(const std::string &path);
+  // Removes the group at `path`; it must not hold tasks anymore
+  static bool Remove(const std::string &path);
+
+  explicit CgroupFreezer(std::string path);
+  ~CgroupFreezer();
+
+  CgroupFreezer(const CgroupFreezer &) = delete;
+  CgroupFreezer &operator=(const CgroupFreezer &) = delete;
+
+  bool Open();
+  const std::string &Path() const { return path_; }
+
+  // Freeze returns once every task is stopped and undoes the request if
+  // that takes longer than kFreezeTimeout
+  bool Freeze();
+  bool Thaw();
+  // Threads in the group
+  size_t CountThreads() const;
+
+private:
+  bool Write(char state);
+  bool IsFrozen() const;
+
+  std::string path_;
+  int freeze_fd_{-1}; // cgroup.freeze
+  int events_fd_{-1}; // cgroup.events
+};
+
+} // namespace memory_tools
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef __MEMORY_TOOLS_CLI_HH__
 #define __MEMORY_TOOLS_CLI_HH__
 #include "CLI/App.hpp"
+#include "process_manager.hh"
 #include "spdlog/common.h"
 #include <cstddef>
 #include <string>
@@ -17,13 +18,25 @@ enum class ErrorType {
 struct CommonOptions {
   bool verbose{false};
   size_t num_threads;
+  size_t chunk_size{4 * 1024 * 1024};
+  MemoryBackend memory_backend{MemoryBackend::Auto};
+  StopMode stop_mode{StopMode::Attach};
+  ScanEngine scan_engine{ScanEngine::Sync};
+  unsigned queue_depth{16};
+  bool skip_nonresident{false};
+  std::string scan_cpus;
+  bool avoid_target_cpus{false};
+  bool numa_buffers{false};
   std::string log_file;
   std::string program_name;
   std::vector<std::string> program_args;
   memory_tools::ErrorType error_type{memory_tools::ErrorType::BitFlip};
   double pointer_error_rate{0.0};
   double non_pointer_error_rate{0.0};
+  size_t pointer_errors{0}; // Exact counts per scan, 0 to use the rates
+  size_t non_pointer_errors{0};
   size_t error_limit{std::numeric_limits<size_t>::max()};
+  std::vector<std::string> inject_regions;
   uint64_t error_seed{0};
   spdlog::level::level_enum log_level{spdlog::level::info};
 };
@@ -32,6 +45,9 @@ struct RunPeriodicOptions : CommonOptions {
   unsigned initial_delay_ms{1000};
   unsigned interval_ms{1000};
   std::optional<size_t> max_iterations{std::nullopt};
+  bool incremental{false};
+  bool concurrent{false};
+  bool snapshot{false};
 };
 
 struct RunCommandOptions : CommonOptions {};
@@ -0,0 +1,38 @@
+#ifndef __MEMORY_TOOLS_COUNTER_RNG_HH__
+#define __MEMORY_TOOLS_COUNTER_RNG_HH__
+
+#include <cstdint>
+
+namespace memory_tools {
+
+/**
+ * @brief Stateless counter-based random numbers
+ *
+ * @details Draw(key, counter) is a pure function of its arguments, so any
+ * thread can compute the number for any counter in any order and the
+ * results never depend on scheduling. It applies the SplitMix64 output
+ * function twice to a keyed counter, with the key folded in once before and
+ * once after the first round.
+ */
+struct CounterRng {
+  static constexpr uint64_t kGamma = 0x9e3779b97f4a7c15ULL;
+
+  static constexpr uint64_t Mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  // Key for one stream of a seed, e.g. one scan of a campaign
+  static constexpr uint64_t Key(uint64_t seed, uint64_t stream) {
+    return Mix(Mix(seed) + stream * kGamma);
+  }
+
+  static constexpr uint64_t Draw(uint64_t key, uint64_t counter) {
+    return Mix(Mix((counter * kGamma) ^ key) + key);
+  }
+};
+
+} // namespace memory_tools
+
+#endif
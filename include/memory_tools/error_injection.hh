@@ -3,12 +3,18 @@
 #define __ERROR_INJECTION_HH__
 
 #include "cli.hh"
+#include "counter_rng.hh"
 #include "injection_strategy.hh"
 #include "process_manager.hh"
+#include "site_sampler.hh"
 #include "spdlog/spdlog.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <chrono>
-#include <random>
-#include <shared_mutex>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
 
 namespace memory_tools {
 
@@ -27,15 +33,15 @@ struct ValueChange {
   std::chrono::steady_clock::time_point injection_time;
 };
 
-class ErrorInjectionStrategy : public InjectionStrategy {
+class ErrorInjectionStrategy final : public InjectionStrategy {
 public:
   class RegionQuota {
   private:
-    mutable std::shared_mutex rw_lock_;
-    size_t heap_errors{0};
-    size_t stack_errors{0};
-    size_t static_errors{0};
-    size_t wildcard_errors{0};
+    // Errors taken so far; scanner threads reserve them concurrently
+    std::atomic<size_t> heap_errors{0};
+    std::atomic<size_t> stack_errors{0};
+    std::atomic<size_t> static_errors{0};
+    std::atomic<size_t> wildcard_errors{0};
 
     // How many errors we want in each region
     size_t heap_quota{0};
@@ -45,71 +51,77 @@ public:
 
     friend ErrorInjectionStrategy;
 
+    // Takes up to `count` of the errors left below `quota`
+    static size_t Take(std::atomic<size_t> &errors, size_t quota,
+                       size_t count) {
+      size_t current = errors.load(std::memory_order_relaxed);
+      size_t taken;
+      do {
+        if (count == 0 || current >= quota) {
+          return 0;
+        }
+        taken = std::min(count, quota - current);
+      } while (!errors.compare_exchange_weak(current, current + taken,
+                                             std::memory_order_relaxed));
+      return taken;
+    }
+
   public:
-    bool Available(PointerType type) const {
-      rw_lock_.lock_shared();
-      bool wildcard_avail = wildcard_errors < wildcard_quota;
-      switch (type) {
-      case PointerType::Heap:
-        return (heap_errors < heap_quota) || wildcard_avail;
-      case PointerType::Stack:
-        return (stack_errors < stack_quota) || wildcard_avail;
-      case PointerType::Static:
-        return (static_errors < static_quota) || wildcard_avail;
-      default:
-        return false;
-      }
-      rw_lock_.unlock_shared();
+    bool Exhausted() const {
+      return heap_errors.load(std::memory_order_relaxed) >= heap_quota &&
+             stack_errors.load(std::memory_order_relaxed) >= stack_quota &&
+             static_errors.load(std::memory_order_relaxed) >= static_quota &&
+             wildcard_errors.load(std::memory_order_relaxed) >= wildcard_quota;
     }
 
-    void Increment(PointerType type) {
-      rw_lock_.lock();
+    // Reserves up to `count` errors for a region of `type`, first from its
+    // own quota and then from the wildcard one, and returns how many were
+    // granted. A whole block of hits costs one compare-and-swap, quotas are
+    // never exceeded, and threads never wait for each other.
+    size_t Reserve(PointerType type, size_t count) {
+      size_t granted;
       switch (type) {
       case PointerType::Heap:
-        if (heap_quota == heap_errors) {
-          wildcard_errors++;
-        } else {
-          heap_errors++;
-        }
+        granted = Take(heap_errors, heap_quota, count);
         break;
       case PointerType::Stack:
-        if (stack_errors == stack_quota) {
-          wildcard_errors++;
-        } else {
-          stack_errors++;
-        }
+        granted = Take(stack_errors, stack_quota, count);
         break;
       case PointerType::Static:
-        if (static_errors == static_quota) {
-          wildcard_errors++;
-        } else {
-          static_errors++;
-        }
+        granted = Take(static_errors, static_quota, count);
         break;
       default:
-        break;
+        return 0;
       }
-      rw_lock_.unlock();
+      return granted + Take(wildcard_errors, wildcard_quota, count - granted);
     }
   };
   static constexpr size_t g_bits_per_byte = 8;
 
   ErrorInjectionStrategy(ErrorType type, double pointer_error_rate,
                          double non_pointer_error_rate, size_t error_limit,
-                         uint64_t seed)
+                         uint64_t seed, size_t pointer_errors = 0,
+                         size_t non_pointer_errors = 0,
+                         std::vector<std::string> region_patterns = {})
       : type_(type), pointer_error_rate_(pointer_error_rate),
         non_pointer_error_rate_(non_pointer_error_rate),
-        rng_(seed ? seed
-                  : static_cast<size_t>(std::chrono::system_clock::now()
-                                            .time_since_epoch()
-                                            .count())),
-        dist_(0.0, 1.0), bit_dist_(0, sizeof(uintptr_t) * g_bits_per_byte - 1) {
+        pointer_errors_(pointer_errors),
+        non_pointer_errors_(non_pointer_errors),
+        region_patterns_(std::move(region_patterns)),
+        samplers_{SiteSampler(pointer_error_rate),
+                  SiteSampler(non_pointer_error_rate)},
+        seed_(seed ? seed
+                   : static_cast<uint64_t>(std::chrono::system_clock::now()
+                                               .time_since_epoch()
+                                               .count())) {
     quota_.wildcard_quota = error_limit;
+    spdlog::info("Error injection seed: {}", seed_);
   }
   ErrorInjectionStrategy(const CommonOptions &opts)
       : ErrorInjectionStrategy(opts.error_type, opts.pointer_error_rate,
                                opts.non_pointer_error_rate, opts.error_limit,
-                               opts.error_seed) {}
+                               opts.error_seed, opts.pointer_errors,
+                               opts.non_pointer_errors, opts.inject_regions) {}
 
   // For monitoring results
   const std::unordered_map<uint64_t, ValueChange> &get_changes() const {
@@ -120,23 +132,107 @@ public:
     current_region = &region;
   }
 
-  bool PreRunner() override { return true; }
+  // Zero rates or a zero error limit never inject, so the scan loop can skip
+  // the corresponding calls
+  unsigned Callbacks() const override {
+    if (quota_.wildcard_quota == 0) {
+      return 0;
+    }
+    return (pointer_error_rate_ > 0 ? kPointerCallback : 0U) |
+           (non_pointer_error_rate_ > 0 ? kNonPointerCallback : 0U);
+  }
+
+  // Every scan draws from its own stream of the seed, and pointers and
+  // non-pointers from separate sub-streams of it
+  bool PreRunner() override {
+    key_ = CounterRng::Key(seed_, iteration_++);
+    for (size_t cls = 0; cls < kNumClasses; cls++) {
+      samplers_[cls].SetKey(CounterRng::Key(key_, cls + 1));
+    }
+    return true;
+  }
+
+  // Read-only words can never be hit, so those regions are not even read
+  RegionFilter Regions() const override {
+    RegionFilter filter;
+    filter.writable_only = true;
+    filter.name_patterns = region_patterns_;
+    return filter;
+  }
+
+  // Exact counts take precedence over the rates
+  SiteRequest Sites() const override {
+    return {pointer_errors_, non_pointer_errors_,
+            CounterRng::Key(key_, kNumClasses + 1)};
+  }
 
   bool HandlePointer(uint64_t addr, uint64_t &value, bool writable,
                      const MemoryRegion &current_region_) override {
-    return inject_error(pointer_error_rate_, quota_, addr, value, writable,
+    return inject_error(kPointerClass, quota_, addr, value, writable,
                         current_region_);
   }
 
   bool HandleNonPointer(uint64_t addr, uint64_t &value, bool writable,
                         const MemoryRegion &current_region_) override {
-    return inject_error(non_pointer_error_rate_, quota_, addr, value, writable,
+    return inject_error(kNonPointerClass, quota_, addr, value, writable,
                         current_region_);
   }
 
+  // Each class has its own sites over all words; a site only counts if the
+  // word there is of that class. This keeps the hit probability of a word
+  // at its class's rate while the cost follows the number of sites.
+  uint64_t HandleBatch(uint64_t addr, std::span<uint64_t> words,
+                       uint64_t pointer_mask, bool writable,
+                       const MemoryRegion &current_region_) override {
+    if (!writable) {
+      return 0;
+    }
+    const uint64_t first_word = addr / sizeof(uint64_t);
+    const uint64_t valid =
+        words.size() < 64 ? (1ULL << words.size()) - 1 : ~0ULL;
+    uint64_t hits =
+        (SiteMask(kPointerClass, first_word, words.size()) & pointer_mask) |
+        (SiteMask(kNonPointerClass, first_word, words.size()) &
+         ~pointer_mask & valid);
+    if (hits == 0) {
+      return 0;
+    }
+
+    const auto type = determine_pointer_type(current_region_);
+    size_t granted =
+        quota_.Reserve(type, static_cast<size_t>(std::popcount(hits)));
+    uint64_t modified = 0;
+    for (; hits != 0 && granted != 0; hits &= hits - 1, granted--) {
+      const auto i = static_cast<size_t>(std::countr_zero(hits));
+      const uint64_t word_addr = addr + i * sizeof(uint64_t);
+      apply_error(word_addr, Draw(word_addr), words[i], type,
+                  current_region_);
+      modified |= 1ULL << i;
+    }
+    return modified;
+  }
+
+  // The sites of both classes, whatever words they fall on
+  uint64_t NextSite(uint64_t addr, uint64_t end_addr,
+                    const MemoryRegion &current_region_) override {
+    if (!current_region_.is_writable || Callbacks() == 0) {
+      return end_addr;
+    }
+    uint64_t next = end_addr / sizeof(uint64_t);
+    for (size_t cls = 0; cls < kNumClasses; cls++) {
+      next = samplers_[cls].Next(addr / sizeof(uint64_t), next,
+                                 next_cursors_[cls]);
+    }
+    return next * sizeof(uint64_t);
+  }
+
+  bool Saturated() const override { return quota_.Exhausted(); }
+
   bool PostRunner() override { return true; }
 
 private:
+  enum SiteClass : size_t { kPointerClass, kNonPointerClass, kNumClasses };
+
   PointerType
   determine_pointer_type(const MemoryRegion &current_region_) const {
     if (current_region_.mapping_name.empty()) {
@@ -153,43 +249,70 @@ private:
     return PointerType::Static;
   }
 
-  bool inject_error(double rate, RegionQuota &quota, uint64_t addr,
+  // Random number of the word at `addr` in the current scan; its low bits
+  // pick the bit to hit
+  uint64_t Draw(uint64_t addr) const {
+    return CounterRng::Draw(key_, addr / sizeof(uint64_t));
+  }
+
+  bool Exact() const {
+    return pointer_errors_ != 0 || non_pointer_errors_ != 0;
+  }
+
+  uint64_t SiteMask(SiteClass cls, uint64_t first_word, size_t count) const {
+    return samplers_[cls].Mask(first_word, count, cursors_[cls]);
+  }
+
+  bool inject_error(SiteClass cls, RegionQuota &quota, uint64_t addr,
                     uint64_t &value, bool writable,
                     const MemoryRegion &current_region_) {
-    auto type = determine_pointer_type(current_region_);
-    if (!writable || dist_(rng_) > rate || !quota.Available(type)) {
+    // Words handed over in exact-count mode were picked by the scanner
+    if (!writable ||
+        (!Exact() && SiteMask(cls, addr / sizeof(uint64_t), 1) == 0)) {
+      return false;
+    }
+    const auto type = determine_pointer_type(current_region_);
+    if (quota.Reserve(type, 1) == 0) {
       return false;
     }
+    apply_error(addr, Draw(addr), value, type, current_region_);
+    return true;
+  }
+
+  // Applies one error whose quota was already reserved
+  void apply_error(uint64_t addr, uint64_t draw, uint64_t &value,
+                   PointerType type, const MemoryRegion &current_region_) {
     auto old_value = value;
-    auto bit = bit_dist_(rng_);
+    auto bit = draw % (sizeof(uintptr_t) * g_bits_per_byte);
 
     switch (type_) {
     case ErrorType::BitFlip:
       value ^= (1ULL << bit);
       break;
     case ErrorType::StuckAtZero:
-      value &= ~(1ULL << bit_dist_(rng_));
+      value &= ~(1ULL << bit);
       break;
     case ErrorType::StuckAtOne:
-      value |= 1ULL << bit_dist_(rng_);
+      value |= 1ULL << bit;
       break;
     }
-    changes_[addr] = ValueChange{
-        old_value,
-        value,
-        type,
-        current_region_.mapping_name,
-        std::chrono::steady_clock::now(),
-    };
+    {
+      // Scanner threads inject concurrently
+      std::lock_guard<std::mutex> lock(changes_mutex_);
+      changes_[addr] = ValueChange{
+          old_value,
+          value,
+          type,
+          current_region_.mapping_name,
+          std::chrono::steady_clock::now(),
+      };
+    }
     spdlog::info("Injected {} error in {} region at {:#x}: {:#x} -> {:#x}",
                  type == PointerType::Heap     ? "heap"
                  : type == PointerType::Stack  ? "stack"
                  : type == PointerType::Static ? "static"
                                                : "unknown",
                  current_region_.mapping_name, addr, old_value, value);
-
-    quota.Increment(type);
-    return true;
   }
 
   void check_value(uint64_t addr, uint64_t current_value) {
@@ -214,9 +337,20 @@ private:
   RegionQuota quota_;
   double pointer_error_rate_;
   double non_pointer_error_rate_;
-  std::mt19937_64 rng_;
-  std::uniform_real_distribution<double> dist_;
-  std::uniform_int_distribution<int> bit_dist_;
+  size_t pointer_errors_;
+  size_t non_pointer_errors_;
+  std::vector<std::string> region_patterns_;
+  SiteSampler samplers_[kNumClasses];
+  uint64_t seed_;
+  uint64_t iteration_{0}; // Scans started so far
+  uint64_t key_{0};       // CounterRng key of the current scan
+  // Scanner threads walk their chunks in ascending order, so each keeps its
+  // own position in the site streams
+  inline static thread_local SiteSampler::Cursor cursors_[kNumClasses];
+  // Separate from cursors_ so NextSite does not send HandleBatch back to the
+  // start of a sampling block
+  inline static thread_local SiteSampler::Cursor next_cursors_[kNumClasses];
+  std::mutex changes_mutex_;
   std::unordered_map<uint64_t, ValueChange> changes_;
   const MemoryRegion *current_region{nullptr};
 };
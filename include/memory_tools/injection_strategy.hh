@@ -2,10 +2,31 @@
 #define __INJECTION_STRATEGY_HH__
 #include "process_manager.hh"
 #include <cstdint>
+#include <span>
 
 namespace memory_tools {
 
+// Callbacks a strategy needs from the scan loop. The loop is specialized for
+// each combination and leaves out the callbacks that are not requested.
+enum StrategyCallback : unsigned {
+  kPointerCallback = 1U << 0,
+  kNonPointerCallback = 1U << 1,
+};
+
+// Words a strategy asks to be handed in exact-count mode
+struct SiteRequest {
+  size_t pointers{0};
+  size_t non_pointers{0};
+  uint64_t key{0}; // CounterRng key the words are picked with
+};
+
 struct InjectionStrategy {
+  virtual ~InjectionStrategy() = default;
+  virtual unsigned Callbacks() const {
+    return kPointerCallback | kNonPointerCallback;
+  }
+  // Regions the strategy needs to see; the scan does not read the others
+  virtual RegionFilter Regions() const { return {}; }
   virtual bool PreRunner() { return true; };
   virtual bool HandlePointer(uint64_t addr, uint64_t &value, bool writable,
                              const MemoryRegion &) {
@@ -21,9 +42,75 @@ struct InjectionStrategy {
     (void)writable;
     return false;
   }
+
+  /**
+   * @brief Handles a block of consecutive words of one region
+   *
+   * @details `words` starts at `addr` and holds at most 64 words. Bit i of
+   * `pointer_mask` is set if words[i] looks like a pointer. Strategies may
+   * change words in place and return the mask of words they modified. Only
+   * those words are written back. The default calls HandlePointer or
+   * HandleNonPointer for every word whose callback the strategy requested.
+   */
+  virtual uint64_t HandleBatch(uint64_t addr, std::span<uint64_t> words,
+                               uint64_t pointer_mask, bool writable,
+                               const MemoryRegion &region) {
+    const unsigned callbacks = Callbacks();
+    uint64_t modified = 0;
+    for (size_t i = 0; i < words.size(); i++) {
+      const uint64_t word_addr = addr + i * sizeof(uint64_t);
+      bool changed = false;
+      if ((pointer_mask >> i) & 1) {
+        changed = (callbacks & kPointerCallback) &&
+                  HandlePointer(word_addr, words[i], writable, region);
+      } else {
+        changed = (callbacks & kNonPointerCallback) &&
+                  HandleNonPointer(word_addr, words[i], writable, region);
+      }
+      modified |= static_cast<uint64_t>(changed) << i;
+    }
+    return modified;
+  }
+
+  /**
+   * @brief Asks for exactly this many words instead of batches
+   *
+   * @details Called after PreRunner. If any words are requested, the scan
+   * counts the pointers and non-pointers of every block and picks the
+   * requested number of each uniformly among the words of writable regions.
+   * A second pass then reads only the blocks holding them and hands each
+   * picked word to HandlePointer or HandleNonPointer. HandleBatch is not
+   * called in this mode.
+   */
+  virtual SiteRequest Sites() const { return {}; }
+
+  /**
+   * @brief First word in [addr, end_addr) the strategy might change
+   *
+   * @details Returns end_addr if there is none. ProcessManager::
+   * ScanConcurrently rereads only the pages holding such words among those
+   * it reuses from the page cache, and hands them over like scanned pages.
+   * The default may change any word, so every reused page is reread.
+   */
+  virtual uint64_t NextSite(uint64_t addr, uint64_t end_addr,
+                            const MemoryRegion &region) {
+    (void)end_addr;
+    (void)region;
+    return addr;
+  }
+
+  // True once the strategy will not change anything else in this scan, e.g.
+  // because its error budget is used up. The scanner then stops reading.
+  virtual bool Saturated() const { return false; }
+
   virtual bool PostRunner() { return true; }
   virtual void SetCurrentRegion(const MemoryRegion & /* region */) {}
 };
+
+// Only counts pointers; the scan loop for it makes no calls per word
+struct ScanOnlyStrategy final : InjectionStrategy {
+  unsigned Callbacks() const override { return 0; }
+};
 } // namespace memory_tools
 
 #endif
@@ -0,0 +1,75 @@
+#ifndef __MEMORY_TOOLS_IO_URING_HH__
+#define __MEMORY_TOOLS_IO_URING_HH__
+
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+
+namespace memory_tools {
+
+/**
+ * @brief Minimal io_uring wrapper for asynchronous positional reads
+ *
+ * @details Talks to the kernel through the raw io_uring_setup/io_uring_enter
+ * syscalls so no liburing dependency is needed. One instance is meant to be
+ * owned by a single thread.
+ */
+class IoUring {
+public:
+  IoUring() = default;
+  ~IoUring();
+
+  IoUring(const IoUring &) = delete;
+  IoUring &operator=(const IoUring &) = delete;
+
+  // Sets up a ring with room for `entries` in-flight requests. Returns false
+  // (with errno set) if io_uring is unavailable, e.g. disabled by sysctl or
+  // blocked by seccomp.
+  bool Init(unsigned entries);
+  bool IsInitialized() const { return ring_fd_ != -1; }
+
+  // Queues a read of `len` bytes at `offset` of `fd`; false if the SQ is full
+  bool PrepareRead(int fd, void *buffer, unsigned len, uint64_t offset,
+                   uint64_t user_data);
+
+  // Submits queued requests and waits for at least `wait_nr` completions
+  bool SubmitAndWait(unsigned wait_nr);
+
+  // Waits for at least `wait_nr` completions without submitting anything
+  bool WaitCompletions(unsigned wait_nr);
+
+  // Takes back the queued requests the kernel has not consumed, e.g. after
+  // SubmitAndWait failed, and returns how many there were
+  unsigned TakeBackUnsubmitted();
+
+  // Pops one completion if available; `result` is the read's return value
+  bool PopCompletion(uint64_t &user_data, int &result);
+
+  // Checks once per process whether io_uring can be set up at all
+  static bool Supported();
+
+private:
+  int ring_fd_{-1};
+  unsigned to_submit_{0};
+
+  void *sq_ring_{nullptr};
+  size_t sq_ring_size_{0};
+  void *cq_ring_{nullptr};
+  size_t cq_ring_size_{0};
+  struct io_uring_sqe *sqes_{nullptr};
+  size_t sqes_size_{0};
+
+  unsigned *sq_head_{nullptr};
+  unsigned *sq_tail_{nullptr};
+  unsigned *sq_mask_{nullptr};
+  unsigned *sq_entries_{nullptr};
+  unsigned *sq_array_{nullptr};
+  unsigned *cq_head_{nullptr};
+  unsigned *cq_tail_{nullptr};
+  unsigned *cq_mask_{nullptr};
+  struct io_uring_cqe *cqes_{nullptr};
+};
+
+} // namespace memory_tools
+
+#endif
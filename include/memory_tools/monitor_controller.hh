@@ -4,16 +4,34 @@
 #include "cli.hh"
 #include "error_injection.hh"
 #include "process_manager.hh"
+#include "thread_pool.hh"
 #include <atomic>
 
 namespace memory_tools {
 // Represents different modes the monitor can operate in
 enum class MonitorMode { Periodic, Command };
 
+// How periodic scans treat the running target
+enum class ScanMethod {
+  Stopped,    // Stop it for the whole scan
+  Concurrent, // Stop only for pages written during the scan
+  Snapshot    // Scan a fork of it, stopping only to fork and write
+};
+
+// Where scanner threads run and scan buffers live
+struct PlacementConfig {
+  std::vector<int> cpus; // Empty: threads float unless a NUMA node is chosen
+  bool avoid_target_cpus{false};
+  bool numa_buffers{false};
+};
+
 struct MonitorConfig {
   std::chrono::milliseconds initial_delay{1000};
   std::chrono::milliseconds interval{1000};
   std::optional<size_t> iteration_limit{std::nullopt};
+  bool incremental{false}; // Soft-dirty based rescans between iterations
+  ScanMethod scan_method{ScanMethod::Stopped};
+  std::string freeze_cgroup; // Target's own cgroup v2 group, for freezing
 };
 
 /**
@@ -46,6 +64,14 @@ private:
   bool HandlePeriodicMode();
   bool HandleCommandMode();
   bool CheckChildRunning();
+  void Sleep(std::chrono::milliseconds duration);
+
+  // Scans with the pool, placing its threads and buffers before the first
+  // scan, once the target has set up its own affinity and memory. Other
+  // methods than ScanMethod::Stopped stop the target themselves.
+  std::optional<ScanStats> Scan(InjectionStrategy &strategy,
+                                ScanMethod method = ScanMethod::Stopped);
+  void PlaceScanners();
 
   // Command mode specific handlers
   bool ProcessCommand();
@@ -57,7 +83,9 @@ private:
   // Core components
   ProcessManager process_manager_;
   ErrorInjectionStrategy injection_strategy_;
-  const size_t num_threads_;
+  ThreadPool scan_pool_; // Scanner threads, kept between scans
+  PlacementConfig placement_;
+  bool placed_{false};
   const MonitorMode mode_;
   const MonitorConfig config_;
 };
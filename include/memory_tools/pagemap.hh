@@ -0,0 +1,148 @@
+#ifndef __MEMORY_TOOLS_PAGEMAP_HH__
+#define __MEMORY_TOOLS_PAGEMAP_HH__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+#include <type_traits>
+#include <vector>
+
+namespace memory_tools {
+
+// A half-open range of pages [start_addr, end_addr)
+struct PageRun {
+  uint64_t start_addr;
+  uint64_t end_addr;
+};
+
+// A run of pages sharing the same Pagemap::kIs* categories
+struct CategoryRun {
+  uint64_t start_addr;
+  uint64_t end_addr;
+  uint64_t categories;
+};
+
+/**
+ * @brief Reader for /proc/<pid>/pagemap
+ *
+ * @details Describes pages of the target by category: present, swapped,
+ * file-backed, mapping the shared zero page, soft-dirty. On kernels with the
+ * PAGEMAP_SCAN ioctl (Linux 6.7+) the kernel returns compact runs of pages
+ * with equal categories. Otherwise every page's 64-bit entry is read and
+ * translated, see Documentation/admin-guide/mm/pagemap.rst.
+ */
+class Pagemap {
+public:
+  // Page categories; same values as the kernel's PAGE_IS_* flags
+  static constexpr uint64_t kIsFile = 1ULL << 2;
+  static constexpr uint64_t kIsPresent = 1ULL << 3;
+  static constexpr uint64_t kIsSwapped = 1ULL << 4;
+  static constexpr uint64_t kIsPfnZero = 1ULL << 5;
+  static constexpr uint64_t kIsSoftDirty = 1ULL << 7;
+
+  // Bits of a classic pagemap entry
+  static constexpr uint64_t kPresent = 1ULL << 63;
+  static constexpr uint64_t kSwapped = 1ULL << 62;
+  static constexpr uint64_t kFilePage = 1ULL << 61;
+  static constexpr uint64_t kExclusive = 1ULL << 56;
+  static constexpr uint64_t kSoftDirty = 1ULL << 55;
+  static constexpr uint64_t kPfnMask = (1ULL << 55) - 1;
+
+  explicit Pagemap(pid_t pid);
+  ~Pagemap();
+
+  Pagemap(const Pagemap &) = delete;
+  Pagemap &operator=(const Pagemap &) = delete;
+
+  bool Open();
+  bool IsOpen() const { return fd_ != -1; }
+  // False once PAGEMAP_SCAN turned out to be unsupported
+  bool UsesScanIoctl() const { return use_scan_ioctl_; }
+
+  // Reads the raw entries for [start_addr, end_addr) into `entries`
+  bool ReadEntries(uint64_t start_addr, uint64_t end_addr,
+                   std::vector<uint64_t> &entries) const;
+
+  // Describes [start_addr, end_addr) as runs of equal categories, using
+  // PAGEMAP_SCAN if available and falling back to ReadEntries otherwise
+  bool ReadCategories(uint64_t start_addr, uint64_t end_addr,
+                      std::vector<CategoryRun> &runs);
+
+  // Appends the runs of pages in [start_addr, end_addr) for which `keep`
+  // holds, merging adjacent pages. keep(categories) decides for a whole run
+  // of equal categories at once; keep(addr, categories) is asked for every
+  // page, for answers that depend on the address. Works through the range
+  // in bounded blocks.
+  template <typename Keep>
+  bool CollectRuns(uint64_t start_addr, uint64_t end_addr, Keep keep,
+                   std::vector<PageRun> &runs);
+
+  // Whether a page's contents are worth reading: present and not the shared
+  // zero page. Swapped and never-touched pages are not.
+  static bool IsResident(uint64_t categories);
+
+  // Translates a classic pagemap entry into categories
+  static uint64_t EntryCategories(uint64_t entry);
+
+  // PFN of the shared zero page, or 0 if PFNs are hidden (no CAP_SYS_ADMIN)
+  static uint64_t ZeroPfn();
+
+  // Whether the kernel tracks soft-dirty bits (CONFIG_MEM_SOFT_DIRTY)
+  static bool SoftDirtySupported();
+
+private:
+  static constexpr size_t kPagesPerBlock = 64 * 1024;
+
+  bool ScanIoctl(uint64_t start_addr, uint64_t end_addr,
+                 std::vector<CategoryRun> &runs) const;
+
+  pid_t pid_;
+  int fd_{-1};
+  size_t page_size_;
+  bool use_scan_ioctl_{true};
+  std::vector<uint64_t> entries_;
+};
+
+template <typename Keep>
+bool Pagemap::CollectRuns(uint64_t start_addr, uint64_t end_addr, Keep keep,
+                          std::vector<PageRun> &runs) {
+  std::vector<CategoryRun> category_runs;
+  const uint64_t block = kPagesPerBlock * page_size_;
+
+  for (uint64_t block_start = start_addr; block_start < end_addr;
+       block_start += block) {
+    uint64_t block_end = std::min(end_addr, block_start + block);
+    category_runs.clear();
+    if (!ReadCategories(block_start, block_end, category_runs)) {
+      return false;
+    }
+
+    auto append = [&](uint64_t start, uint64_t end) {
+      if (!runs.empty() && runs.back().end_addr == start) {
+        runs.back().end_addr = end;
+      } else {
+        runs.push_back({start, end});
+      }
+    };
+    for (const auto &category_run : category_runs) {
+      if constexpr (std::is_invocable_r_v<bool, Keep, uint64_t>) {
+        if (keep(category_run.categories)) {
+          append(category_run.start_addr, category_run.end_addr);
+        }
+      } else {
+        for (uint64_t addr = category_run.start_addr;
+             addr < category_run.end_addr; addr += page_size_) {
+          if (keep(addr, category_run.categories)) {
+            append(addr, addr + page_size_);
+          }
+        }
+      }
+    }
+  }
+  return true;
+}
+
+} // namespace memory_tools
+
+#endif
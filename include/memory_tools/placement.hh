@@ -0,0 +1,66 @@
+#ifndef __MEMORY_TOOLS_PLACEMENT_HH__
+#define __MEMORY_TOOLS_PLACEMENT_HH__
+
+#include <cstddef>
+#include <new>
+#include <optional>
+#include <pthread.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <vector>
+
+namespace memory_tools {
+
+// Parses a kernel-style CPU list such as "0-3,8,10-11" into sorted CPU ids
+bool ParseCpuList(const std::string &list, std::vector<int> &cpus);
+
+// CPUs the calling process may run on
+std::vector<int> AllowedCpus();
+
+// CPUs any thread of `pid` may run on (union of the threads' affinity masks)
+std::vector<int> TargetCpus(pid_t pid);
+
+// CPUs of NUMA node `node`, empty if the node does not exist
+std::vector<int> NodeCpus(int node);
+
+// NUMA node holding most of the target's pages according to
+// /proc/<pid>/numa_maps; nullopt on non-NUMA kernels
+std::optional<int> TargetMemoryNode(pid_t pid);
+
+// Restricts a thread to a single CPU
+bool PinThread(pthread_t thread, int cpu);
+
+// Restricts a thread to a set of CPUs
+bool RestrictThread(pthread_t thread, const std::vector<int> &cpus);
+
+// Binds the whole pages of [addr, addr + size) to `node`, moving pages that
+// are already allocated elsewhere
+bool BindToNode(void *addr, size_t size, int node);
+
+// Allocates straight from mmap, so an allocation starts on a page boundary
+// and owns all of its pages, and BindToNode can place every byte of it
+template <typename T> struct PageAllocator {
+  using value_type = T;
+
+  PageAllocator() = default;
+  template <typename U> PageAllocator(const PageAllocator<U> &) {}
+
+  T *allocate(size_t n) {
+    void *memory = mmap(nullptr, n * sizeof(T), PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T *>(memory);
+  }
+  void deallocate(T *memory, size_t n) { munmap(memory, n * sizeof(T)); }
+
+  template <typename U> bool operator==(const PageAllocator<U> &) const {
+    return true;
+  }
+};
+
+} // namespace memory_tools
+
+#endif
@@ -1,16 +1,52 @@
 #ifndef PROCESS_BASE_HH
 #define PROCESS_BASE_HH
 
+#include "address_map.hh"
+#include "placement.hh"
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/user.h>
+#include <utility>
 #include <vector>
 
 namespace memory_tools {
 
 struct InjectionStrategy;
+struct SiteRequest;
+class CgroupFreezer;
+class IoUring;
+class ThreadPool;
+
+// How target memory is accessed in bulk
+enum class MemoryBackend {
+  Auto,      // process_vm_readv, switching to /proc/<pid>/mem if unusable
+  ProcessVm, // process_vm_readv/process_vm_writev only
+  ProcMem,   // pread/preadv/pwrite on /proc/<pid>/mem
+};
+
+// How scanner threads wait for reads
+enum class ScanEngine {
+  Sync,    // Each thread blocks on one chunk read at a time
+  IoUring, // Each thread keeps a queue of /proc/<pid>/mem reads in flight
+  Pipeline, // Reader and classifier threads connected by SPSC rings
+};
+
+// How the target is stopped for a scan
+enum class StopMode {
+  Attach, // PTRACE_ATTACH before and PTRACE_DETACH after every scan
+  Seize,  // PTRACE_SEIZE once, then PTRACE_INTERRUPT/PTRACE_CONT per scan
+  Group,  // Like Seize for every thread, including ones cloned later
+  Freeze, // cgroup v2 freezer of the target's own cgroup; nothing is traced
+};
 
 // Memory region information (moved from process_scanner.hh)
 struct MemoryRegion {
@@ -26,6 +62,29 @@ struct MemoryRegion {
   bool contains(uintptr_t addr) const;
 };
 
+// Regions a scan reads; the default takes every readable region
+struct RegionFilter {
+  enum Kind : unsigned {
+    kHeap = 1U << 0,   // [heap]
+    kStack = 1U << 1,  // [stack]
+    kStatic = 1U << 2, // Everything else: binaries, libraries, other maps
+    kAllKinds = kHeap | kStack | kStatic,
+  };
+  enum class Backing {
+    Any,
+    Anonymous, // No file; includes [heap], [stack] and other [...] maps
+    File,
+  };
+
+  bool writable_only{false};
+  unsigned kinds{kAllKinds};
+  Backing backing{Backing::Any};
+  // A region must contain one of these in its name, if any are given
+  std::vector<std::string> name_patterns;
+
+  bool Matches(const MemoryRegion &region) const;
+};
+
 struct ScanStats {
   uint64_t total_bytes_scanned{0};
   uint64_t bytes_readable{0};
@@ -34,12 +93,50 @@ struct ScanStats {
   uint64_t regions_scanned{0};
   uint64_t pointers_found{0};
   uint64_t bytes_skipped{0};
+  uint64_t bytes_not_resident{0}; // Left out by the pagemap pre-pass
+  uint64_t bytes_reused{0}; // Clean pages counted from the incremental cache
+  uint64_t bytes_filtered{0}; // Regions the strategy did not ask for
   int64_t scan_time_ms{0};
+  bool stopped_early{false}; // The strategy saturated before the end
+  double stop_to_read_ms{0}; // From requesting the stop to the first read
+  double freeze_ms{0};       // From requesting the stop until all stopped
+  size_t threads_stopped{0};
+  // ProcessManager::ScanConcurrently only
+  double concurrent_ms{0};      // Pass over the running target
+  uint64_t concurrent_bytes{0}; // Read by that pass
+  double stopped_ms{0};         // From stopping to resuming the target
+  // ProcessManager::ScanSnapshot only
+  bool snapshot{false};
+  uint64_t writes_skipped{0}; // Changed in the target since the snapshot
+  // Fraction of the scan each pipeline stage spent working (pipeline engine)
+  double reader_occupancy{0};
+  double classifier_occupancy{0};
+  double writer_occupancy{0};
+  // Time each scanner thread spent on work units and waiting for the others
+  std::vector<double> thread_busy_ms;
+  std::vector<double> thread_idle_ms;
+
+  // Accumulates the counters of a per-thread partial result
+  void Merge(const ScanStats &other);
   friend std::ostream &operator<<(std::ostream &os, const ScanStats &stats);
 };
 
+// Words of one readable region, counted per block of
+// ProcessManager::kCountBlockSize bytes for exact-count injection
+struct RegionStats {
+  const MemoryRegion *region;
+  size_t pointer_count{0};
+  size_t nonpointer_count{0};
+  uint64_t region_start; // Address of the first block
+  std::vector<uint32_t> block_pointers;
+  std::vector<uint32_t> block_words; // Scanned words, pointers included
+};
+
 class ProcessManager {
 public:
+  // Granularity of the word counts exact-count injection selects from
+  static constexpr uint64_t kCountBlockSize = 64 * 1024;
+
   explicit ProcessManager(pid_t target_pid);
   virtual ~ProcessManager();
 
@@ -47,10 +144,17 @@ public:
   ProcessManager(const ProcessManager &) = delete;
   ProcessManager &operator=(const ProcessManager &) = delete;
 
-  // Core process management
+  // Core process management. Attach stops the target and Detach lets it run
+  // again; in StopMode::Seize the target stays traced in between.
   bool Attach();
   bool Detach();
   bool IsAttached() const { return is_attached_; }
+  bool IsSeized() const { return is_seized_; }
+  // Ends tracing in StopMode::Seize
+  bool Release();
+  // Forwards the signals a seized, running target stopped for; false once
+  // the target has exited
+  bool PollTarget();
   // Returns PID of traced process
   pid_t GetPid() const { return target_pid_; }
 
@@ -59,15 +163,56 @@ public:
   bool WriteMemory(uint64_t addr, const void *buffer, size_t size) const;
   bool RefreshMemoryMap();
 
+  // Must be set before Attach to take effect
+  void SetMemoryBackend(MemoryBackend backend) { backend_ = backend; }
+  void SetStopMode(StopMode mode) { stop_mode_ = mode; }
+  // cgroup v2 group holding only the target, for StopMode::Freeze
+  bool SetFreezeCgroup(const std::string &path);
+
+  // queue_depth is the number of in-flight reads (IoUring) or buffers per
+  // reader (Pipeline). IoUring falls back to Sync at scan time if io_uring
+  // or /proc/<pid>/mem is unavailable, Pipeline if the pool has fewer than
+  // 3 threads
+  void SetScanEngine(ScanEngine engine, unsigned queue_depth);
+
+  // Skip pages that are not resident (never touched, swapped out, or the
+  // shared zero page) according to /proc/<pid>/pagemap
+  void SetSkipNonResident(bool skip) { skip_nonresident_ = skip; }
+
+  // Rescan only pages written since the previous scan (soft-dirty), reusing
+  // cached pointer counts for the rest. Strategies only see rescanned pages.
+  void SetIncremental(bool incremental) { incremental_ = incremental; }
+  // NUMA node scan buffers are bound to, -1 for the default policy
+  void SetBufferNode(int node) { buffer_node_ = node; }
+
+  // Size of the per-thread buffer each scan read fills (rounded to pages)
+  void SetChunkSize(size_t chunk_size);
+  size_t GetChunkSize() const { return chunk_size_; }
+
   // Scanner functionality
   std::optional<ScanStats> ScanForPointers(InjectionStrategy &strategy,
                                            size_t num_threads_);
+  // Scans on the threads of a pool that outlives the scan
+  std::optional<ScanStats> ScanForPointers(InjectionStrategy &strategy,
+                                           ThreadPool &pool);
+  // Counts while the target runs and stops it only for the pages it wrote
+  // meanwhile; the target must not be attached. Scans incrementally for the
+  // duration of the call, whatever SetIncremental was given.
+  std::optional<ScanStats> ScanConcurrently(InjectionStrategy &strategy,
+                                            ThreadPool &pool);
+  // Scans a copy-on-write fork of the target, which only stops to fork and
+  // to take the changed words; the target must not be attached
+  std::optional<ScanStats> ScanSnapshot(InjectionStrategy &strategy,
+                                        ThreadPool &pool);
 
   // Checkpoint Functionality
   bool CreateCheckpoint();
   bool RestoreCheckpoint();
 
 private:
+  // Scan buffers start on a page so that all of them can be bound to a node
+  using ScanBuffer = std::vector<uint8_t, PageAllocator<uint8_t>>;
+
   struct MemoryChunk {
     uint64_t addr;
     std::vector<uint8_t> data;
@@ -77,15 +222,191 @@ private:
   // Pointer validation helpers
   bool IsValidPointerTarget(uint64_t addr) const;
   bool IsLikelyPointer(uint64_t value) const;
-  void ScanRegion(const MemoryRegion &region, InjectionStrategy &strategy,
-                  ScanStats &stats);
+  uint64_t PointerMask(const uint8_t *data, size_t words) const;
+
+  // A contiguous piece of one region backed by part of a scan buffer
+  struct ReadExtent {
+    const MemoryRegion *region;
+    uint64_t addr;
+    uint8_t *data;
+    size_t size;
+  };
+
+  // Stopping and resuming in StopMode::Seize and StopMode::Group
+  bool Interrupt();
+  bool SeizeThreads();
+  bool StopThreads();
+  bool WaitForStops();
+  bool HandleThreadStatus(pid_t tid, int status, bool stopping);
+  bool FreezeCgroup();
+  void OpenMemFile();
+  void PollDuring(const std::function<void()> &pass);
+
+  // Fork snapshots
+  pid_t ForkTarget();
+  uint64_t FindSyscallInstruction() const;
+  bool LogSnapshotWrite(uint64_t addr, const void *buffer, size_t size) const;
+
+  // /proc/<pid>/mem backend selection
+  bool UseProcMem() const;
+  bool SwitchToProcMem(int error) const;
+
+  // Modified word queued for the pipeline's write-back stage
+  struct WriteBack {
+    uint64_t addr;
+    uint64_t value;
+  };
+
+  // io_uring ring given up with reads in flight, kept along with the buffer
+  // the kernel may still write to until all of them completed
+  struct StuckRing {
+    ScanBuffer buffer;
+    std::unique_ptr<IoUring> ring; // Closed before the buffer is freed
+    size_t pending;                // Reads not completed yet
+  };
+  // More than this and the io_uring engine is not used anymore
+  static constexpr size_t kMaxStuckRings = 4;
+
+  // Word changed in a fork snapshot, to be written to the target
+  struct SnapshotWrite {
+    uint64_t addr;
+    uint64_t original; // Value in the snapshot
+    uint64_t value;
+  };
+
+  // Part of a region that a scan has to read
+  struct ScanRange {
+    const MemoryRegion *region;
+    uint64_t start_addr;
+    uint64_t end_addr;
+  };
+
+  // Position in a list of ranges that is being scanned chunk by chunk
+  struct RangeCursor {
+    std::vector<ScanRange>::const_iterator it;
+    std::vector<ScanRange>::const_iterator end;
+    uint64_t addr;
+
+    explicit RangeCursor(const std::vector<ScanRange> &ranges);
+    bool Done() const { return it == end; }
+  };
+
+  void PrepareScanBuffers(size_t count, size_t size);
+
+  // Work list construction
+  bool BuildWorkList(const RegionFilter &filter,
+                     std::vector<ScanRange> &ranges, ScanStats &stats,
+                     std::vector<ScanRange> *clean = nullptr);
+  std::vector<std::vector<ScanRange>>
+  SplitWorkUnits(const std::vector<ScanRange> &ranges, size_t unit_size) const;
+
+  // Incremental scanning
+  void SyncPageCache();
+  uint16_t *PageCacheFor(const MemoryRegion &region, uint64_t addr) const;
+  bool ClearSoftDirty() const;
+
+  // Chunked reading with fault isolation
+  ssize_t ReadVectored(const struct iovec *local_iov,
+                       const struct iovec *remote_iov, size_t count,
+                       bool proc_mem) const;
+  ssize_t ReadRange(uint64_t addr, uint8_t *data, size_t size) const;
+  size_t ReadBisect(const ReadExtent &extent,
+                    std::vector<ReadExtent> &readable) const;
+  size_t ReadChunk(const std::vector<ReadExtent> &extents,
+                   std::vector<ReadExtent> &readable) const;
+  void FillChunk(RangeCursor &cursor, uint8_t *buffer, size_t size,
+                 size_t max_extents, std::vector<ReadExtent> &extents) const;
+  size_t CompleteRead(const ReadExtent &extent, int result,
+                      std::vector<ReadExtent> &readable) const;
+  void ReapStuckRings();
+  void ScanRegions(const std::vector<ScanRange> &ranges,
+                   ScanBuffer &buffer, InjectionStrategy &strategy,
+                   ScanStats &stats);
+  void ScanRegions(RangeCursor &cursor, ScanBuffer &buffer,
+                   InjectionStrategy &strategy, ScanStats &stats);
+  bool ScanRegionsAsync(const std::vector<ScanRange> &ranges,
+                        ScanBuffer &buffer,
+                        std::unique_ptr<IoUring> &ring,
+                        InjectionStrategy &strategy, ScanStats &stats);
+  void ScanPipeline(ThreadPool &pool,
+                    const std::vector<std::vector<ScanRange>> &reader_ranges,
+                    InjectionStrategy &strategy, ScanStats &stats);
+  void ScanChunk(const MemoryRegion &region, uint64_t addr, uint8_t *data,
+                 size_t size, InjectionStrategy &strategy, ScanStats &stats,
+                 std::vector<WriteBack> *deferred_writes = nullptr);
+  bool ScanStopped(const InjectionStrategy &strategy);
+  std::optional<ScanStats> ScanAttached(InjectionStrategy &strategy,
+                                        ThreadPool &pool, bool clean_pages);
+  void RunScanPass(InjectionStrategy &strategy, ThreadPool &pool,
+                   const std::vector<ScanRange> &ranges, ScanStats &stats);
+
+  // Exact-count injection
+  std::vector<RegionStats> NewRegionStats() const;
+  void CountCachedWords(std::vector<RegionStats> &region_stats) const;
+  void InjectSites(InjectionStrategy &strategy, ThreadPool &pool,
+                   const SiteRequest &request,
+                   const std::vector<ScanRange> &ranges,
+                   std::vector<RegionStats> &region_stats);
+  void InjectCleanPages(InjectionStrategy &strategy, ThreadPool &pool,
+                        const std::vector<ScanRange> &clean);
+
+  // Word loop of ScanChunk, specialized per strategy type and callbacks
+  using ChunkKernel = void (ProcessManager::*)(
+      const MemoryRegion &region, uint64_t addr, uint8_t *data, size_t size,
+      InjectionStrategy &strategy, ScanStats &stats, uint16_t *page_counts,
+      std::vector<WriteBack> *deferred_writes);
+  template <typename Strategy, bool kPointers, bool kNonPointers>
+  void ClassifyChunk(const MemoryRegion &region, uint64_t addr, uint8_t *data,
+                     size_t size, InjectionStrategy &strategy,
+                     ScanStats &stats, uint16_t *page_counts,
+                     std::vector<WriteBack> *deferred_writes);
+  template <typename Strategy>
+  static ChunkKernel SelectChunkKernel(unsigned callbacks);
+  static ChunkKernel SelectChunkKernel(InjectionStrategy &strategy);
   std::string CheckpointDir() const;
 
   pid_t target_pid_;
   bool is_attached_;
+  StopMode stop_mode_{StopMode::Attach};
+  bool is_seized_{false};
+  bool exited_{false}; // Seen exiting while seized
+  // A seized thread: only the target in StopMode::Seize, all in Group
+  struct TracedThread {
+    bool stopped{false};
+    bool group_stopped{false}; // In a job control stop
+  };
+  std::map<pid_t, TracedThread> threads_;
+  std::chrono::steady_clock::time_point stop_requested_;
+  double freeze_ms_{0}; // Time the last stop took
+  size_t threads_stopped_{0};
+  std::unique_ptr<CgroupFreezer> freezer_; // StopMode::Freeze only
+  // Set when this instance scans a fork snapshot, whose writes are logged
+  bool snapshot_{false};
+  mutable std::mutex snapshot_mutex_;
+  mutable std::vector<SnapshotWrite> snapshot_writes_;
   size_t page_size_;
+  size_t chunk_size_;
+  MemoryBackend backend_;
+  ScanEngine engine_;
+  unsigned queue_depth_;
+  bool skip_nonresident_;
+  bool incremental_;
+  // Pointers found per page, keyed by region bounds so the cache survives
+  // RefreshMemoryMap; SyncPageCache carries counts over when bounds change.
+  // region_cache_ points into it for each readable region.
+  std::map<std::pair<uint64_t, uint64_t>, std::vector<uint16_t>> page_cache_;
+  std::vector<uint16_t *> region_cache_;
+  int mem_fd_; // Open /proc/<pid>/mem while attached, -1 otherwise
+  mutable std::atomic<bool> use_proc_mem_;
+  std::vector<ScanBuffer> scan_buffers_; // Reused across scans
+  std::mutex stuck_rings_mutex_;
+  std::vector<StuckRing> stuck_rings_;
+  int buffer_node_{-1};
+  ChunkKernel chunk_kernel_{nullptr}; // Picked for each scan's strategy
+  std::atomic<bool> scan_stopped_{false}; // Set once the strategy saturates
   std::vector<MemoryRegion> readable_regions_; // Regions we can read from
   std::vector<MemoryRegion> all_regions_;      // All memory regions
+  AddressMap address_map_; // Mapped pages of all_regions_, for pointer checks
 };
 
 } // namespace memory_tools
@@ -0,0 +1,125 @@
+#ifndef __MEMORY_TOOLS_SITE_SAMPLER_HH__
+#define __MEMORY_TOOLS_SITE_SAMPLER_HH__
+
+#include "counter_rng.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace memory_tools {
+
+/**
+ * @brief Picks every word independently with probability `rate` by skipping
+ * ahead geometric gaps
+ *
+ * @details The address space is cut into fixed sampling blocks of 64 KiB.
+ * Within a block, the gaps between consecutive sites are geometric draws
+ * from CounterRng, keyed by the block and the site's ordinal. The site set
+ * therefore depends only on the key and not on the order in which words are
+ * visited. The cost is one draw per site instead of one per word.
+ *
+ * A Cursor caches the position in the current block. Callers keep one per
+ * thread and sampler, and visit words in ascending order within a block to
+ * benefit from it. Entering a block elsewhere than at its start, or going
+ * backwards, walks the block from its start again.
+ */
+class SiteSampler {
+public:
+  static constexpr unsigned kBlockShift = 13; // 2^13 words = 64 KiB
+  static constexpr uint64_t kBlockWords = 1ULL << kBlockShift;
+
+  struct Cursor {
+    const SiteSampler *sampler{nullptr};
+    uint64_t key{0};
+    uint64_t block{~0ULL};
+    uint64_t index{0}; // Sites of the block drawn so far
+    uint64_t from{0};  // `next` is the first site at or after this word
+    uint64_t next{0};
+  };
+
+  SiteSampler() = default;
+  explicit SiteSampler(double rate)
+      : rate_(rate), log_miss_(std::log1p(-std::fmin(rate, 1.0))) {}
+
+  void SetKey(uint64_t key) { key_ = key; }
+  bool Empty() const { return !(rate_ > 0); }
+
+  // Mask of the sites among words [first_word, first_word + count), where
+  // `count` is at most 64
+  uint64_t Mask(uint64_t first_word, size_t count, Cursor &cursor) const {
+    if (Empty()) {
+      return 0;
+    }
+    const uint64_t block = first_word >> kBlockShift;
+    const uint64_t block_end = (block + 1) << kBlockShift;
+    if (first_word + count > block_end) {
+      const auto head = static_cast<size_t>(block_end - first_word);
+      return Mask(first_word, head, cursor) |
+             Mask(block_end, count - head, cursor) << head;
+    }
+    if (cursor.sampler != this || cursor.key != key_ ||
+        cursor.block != block || first_word < cursor.from) {
+      cursor = {this, key_, block, 0, block << kBlockShift, 0};
+      cursor.next = cursor.from + Gap(block, cursor.index++);
+    }
+
+    const uint64_t end = first_word + count;
+    uint64_t mask = 0;
+    while (cursor.next < end) {
+      if (cursor.next >= first_word) {
+        mask |= 1ULL << (cursor.next - first_word);
+      }
+      cursor.from = cursor.next + 1;
+      cursor.next = cursor.from + Gap(block, cursor.index++);
+    }
+    cursor.from = end;
+    return mask;
+  }
+
+  // First site among words [first_word, end), or `end` if there is none.
+  // Costs one draw per site passed and per sampling block without sites.
+  uint64_t Next(uint64_t first_word, uint64_t end, Cursor &cursor) const {
+    if (Empty()) {
+      return end;
+    }
+    while (first_word < end) {
+      const uint64_t block = first_word >> kBlockShift;
+      const uint64_t block_end = (block + 1) << kBlockShift;
+      if (cursor.sampler != this || cursor.key != key_ ||
+          cursor.block != block || first_word < cursor.from) {
+        cursor = {this, key_, block, 0, block << kBlockShift, 0};
+        cursor.next = cursor.from + Gap(block, cursor.index++);
+      }
+      while (cursor.next < first_word) {
+        cursor.from = cursor.next + 1;
+        cursor.next = cursor.from + Gap(block, cursor.index++);
+      }
+      cursor.from = first_word;
+      if (cursor.next < block_end) {
+        return std::min(cursor.next, end);
+      }
+      first_word = block_end;
+    }
+    return end;
+  }
+
+private:
+  // Words skipped before the next site: floor(ln(u) / ln(1 - rate))
+  uint64_t Gap(uint64_t block, uint64_t index) const {
+    const uint64_t draw =
+        CounterRng::Draw(key_, (block << (kBlockShift + 1)) | index);
+    const double u = static_cast<double>((draw >> 11) + 1) * 0x1p-53;
+    const double gap = std::floor(std::log(u) / log_miss_);
+    return gap < static_cast<double>(kBlockWords) ? static_cast<uint64_t>(gap)
+                                                  : kBlockWords;
+  }
+
+  double rate_{0};
+  double log_miss_{0};
+  uint64_t key_{0};
+};
+
+} // namespace memory_tools
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef __MEMORY_TOOLS_SPSC_RING_HH__
+#define __MEMORY_TOOLS_SPSC_RING_HH__
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <vector>
+
+namespace memory_tools {
+
+/**
+ * @brief Bounded lock-free single-producer/single-consumer ring
+ *
+ * @details Exactly one thread may call TryPush and exactly one (other) thread
+ * may call TryPop. Each side caches the other side's index so the shared
+ * cache line is only touched when the ring looks full or empty.
+ */
+template <typename T> class SpscRing {
+public:
+  explicit SpscRing(size_t capacity)
+      : mask_(std::bit_ceil(capacity) - 1), slots_(mask_ + 1) {}
+
+  SpscRing(const SpscRing &) = delete;
+  SpscRing &operator=(const SpscRing &) = delete;
+
+  bool TryPush(const T &item) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - cached_head_ > mask_) {
+      cached_head_ = head_.load(std::memory_order_acquire);
+      if (tail - cached_head_ > mask_) {
+        return false;
+      }
+    }
+    slots_[tail & mask_] = item;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool TryPop(T &item) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == cached_tail_) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (head == cached_tail_) {
+        return false;
+      }
+    }
+    item = slots_[head & mask_];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t Capacity() const { return mask_ + 1; }
+
+private:
+  static constexpr size_t kCacheLine = 64;
+
+  // Consumer side
+  alignas(kCacheLine) std::atomic<size_t> head_{0};
+  size_t cached_tail_{0};
+
+  // Producer side
+  alignas(kCacheLine) std::atomic<size_t> tail_{0};
+  size_t cached_head_{0};
+
+  alignas(kCacheLine) const size_t mask_;
+  std::vector<T> slots_;
+};
+
+} // namespace memory_tools
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef __MEMORY_TOOLS_THREAD_POOL_HH__
+#define __MEMORY_TOOLS_THREAD_POOL_HH__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace memory_tools {
+
+/**
+ * @brief Persistent worker threads with per-worker work-stealing deques
+ *
+ * @details Run hands out tasks 0..n-1 in contiguous blocks, one block per
+ * worker deque. Each worker takes tasks from the front of its own deque.
+ * A worker whose deque is empty steals from the back of the others. This
+ * rebalances the work when one worker received a much larger share, e.g.
+ * all the units of a huge heap. Threads are created once and sleep between
+ * runs.
+ */
+class ThreadPool {
+public:
+  using Task = std::function<void(size_t worker, size_t task)>;
+
+  // Time one worker spent running tasks and waiting for the run to finish
+  struct WorkerTime {
+    std::chrono::nanoseconds busy{0};
+    std::chrono::nanoseconds idle{0};
+  };
+
+  explicit ThreadPool(size_t num_threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  size_t Size() const { return workers_.size(); }
+
+  // Pins worker i to cpus[i % cpus.size()]
+  bool Pin(const std::vector<int> &cpus);
+
+  // Runs task(worker, index) for every index in [0, num_tasks) and returns
+  // once all of them finished. Must not be called from a task.
+  void Run(size_t num_tasks, const Task &task);
+
+  // Abandons the tasks of the current run that have not started yet. Meant
+  // to be called from a task; Run still waits for the running ones.
+  void Cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+
+  // Per-worker times of the last Run
+  const std::vector<WorkerTime> &LastRunTimes() const { return times_; }
+
+private:
+  static constexpr size_t kCacheLine = 64;
+
+  struct alignas(kCacheLine) WorkerQueue {
+    std::mutex mutex;
+    std::deque<size_t> tasks;
+  };
+
+  void WorkerLoop(size_t worker);
+  bool Pop(size_t worker, size_t &task);
+  bool Steal(size_t worker, size_t &task);
+
+  std::vector<std::thread> workers_;
+  std::vector<WorkerQueue> queues_;
+  std::vector<WorkerTime> times_;
+
+  std::mutex mutex_;
+  std::condition_variable start_cv_;
+  std::condition_variable done_cv_;
+  const Task *task_{nullptr};
+  uint64_t generation_{0}; // Bumped by every Run
+  size_t finished_{0};     // Workers done with the current run
+  std::atomic<bool> cancelled_{false};
+  bool stop_{false};
+};
+
+} // namespace memory_tools
+
+#endif
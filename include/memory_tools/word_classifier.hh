@@ -0,0 +1,29 @@
+#ifndef __MEMORY_TOOLS_WORD_CLASSIFIER_HH__
+#define __MEMORY_TOOLS_WORD_CLASSIFIER_HH__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace memory_tools {
+
+// Words classified per CandidateMask call, one mask bit each
+constexpr size_t kClassifyBlockWords = 64;
+
+/**
+ * @brief Cheap pointer pre-filter over a block of words
+ *
+ * @details Bit i of the result is set if the i-th 64-bit word at `data`
+ * passes the register-only checks of IsLikelyPointer: non-zero, 2-byte
+ * aligned and canonical. Only those words need an address map lookup.
+ * `words` is at most kClassifyBlockWords and `data` needs no alignment.
+ * Full blocks use an AVX-512 or AVX2 kernel when the CPU supports one.
+ * Short blocks and other CPUs use the scalar kernel.
+ */
+uint64_t CandidateMask(const uint8_t *data, size_t words);
+
+// Name of the kernel CandidateMask picked for full blocks
+const char *ClassifierKernelName();
+
+} // namespace memory_tools
+
+#endif
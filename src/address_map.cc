@@ -0,0 +1,80 @@
+#include "address_map.hh"
+#include <algorithm>
+#include <bit>
+
+namespace memory_tools {
+
+AddressMap::AddressMap(size_t page_size)
+    : page_shift_(static_cast<unsigned>(std::countr_zero(page_size))),
+      pages_per_block_(1ULL << (kBlockShift - page_shift_)),
+      words_per_block_(std::max<size_t>(1, pages_per_block_ / 64)) {
+  Clear();
+}
+
+void AddressMap::Clear() {
+  root_.clear();
+  directories_.assign(kBlocksPerDirectory, kEmptyBitmap);
+  bitmaps_.assign(words_per_block_, 0);
+  bitmaps_.resize(2 * words_per_block_, ~0ULL);
+  high_ranges_.clear();
+}
+
+uint32_t *AddressMap::BlockEntry(uint64_t addr) {
+  const uint64_t root = addr >> kRootShift;
+  if (root >= root_.size()) {
+    root_.resize(root + 1, 0);
+  }
+  if (root_[root] == 0) {
+    root_[root] =
+        static_cast<uint32_t>(directories_.size() / kBlocksPerDirectory);
+    directories_.resize(directories_.size() + kBlocksPerDirectory,
+                        kEmptyBitmap);
+  }
+  return &directories_[root_[root] * kBlocksPerDirectory +
+                       ((addr >> kBlockShift) & (kBlocksPerDirectory - 1))];
+}
+
+void AddressMap::Add(uint64_t start_addr, uint64_t end_addr) {
+  constexpr uint64_t kLimit = 1ULL << kAddressBits;
+  if (end_addr > kLimit) {
+    high_ranges_.emplace_back(std::max(start_addr, kLimit), end_addr);
+    end_addr = kLimit;
+  }
+
+  const uint64_t block_size = 1ULL << kBlockShift;
+  for (uint64_t addr = start_addr; addr < end_addr;) {
+    const uint64_t block_start = addr & ~(block_size - 1);
+    const uint64_t block_end = block_start + block_size;
+    const uint64_t next = std::min(end_addr, block_end);
+    uint32_t *entry = BlockEntry(addr);
+
+    if (addr == block_start && next == block_end) {
+      *entry = kFullBitmap;
+    } else if (*entry != kFullBitmap) {
+      if (*entry == kEmptyBitmap) {
+        *entry = static_cast<uint32_t>(bitmaps_.size() / words_per_block_);
+        bitmaps_.resize(bitmaps_.size() + words_per_block_, 0);
+      }
+      uint64_t *bitmap = &bitmaps_[*entry * words_per_block_];
+      for (uint64_t page = (addr - block_start) >> page_shift_,
+                    last = (next - block_start) >> page_shift_;
+           page < last; page++) {
+        bitmap[page / 64] |= 1ULL << (page % 64);
+      }
+    }
+    addr = next;
+  }
+}
+
+bool AddressMap::ContainsHigh(uint64_t addr) const {
+  auto it = std::upper_bound(
+      high_ranges_.begin(), high_ranges_.end(), addr,
+      [](uint64_t addr_, const auto &range) { return addr_ < range.first; });
+  if (it == high_ranges_.begin()) {
+    return false;
+  }
+  --it;
+  return addr < it->second;
+}
+
+} // namespace memory_tools
@@ -0,0 +1,170 @@
+#include "cgroup_freezer.hh"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <poll.h>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace memory_tools {
+
+namespace {
+// Mount point of the cgroup v2 hierarchy according to /proc/self/mountinfo,
+// whose lines end in " - <fstype> <source> <options>"
+std::optional<std::string> Cgroup2Mount() {
+  std::ifstream mountinfo("/proc/self/mountinfo");
+  std::string line;
+  while (std::getline(mountinfo, line)) {
+    const size_t separator = line.find(" - ");
+    if (separator == std::string::npos ||
+        line.compare(separator + 3, 8, "cgroup2 ") != 0) {
+      continue;
+    }
+    // Fields: ID, parent ID, major:minor, root, mount point, ...
+    std::istringstream fields(line.substr(0, separator));
+    std::string field, mount_point;
+    for (int i = 0; i < 5 && fields >> field; i++) {
+      mount_point = field;
+    }
+    return mount_point;
+  }
+  errno = ENOENT;
+  return std::nullopt;
+}
+
+// The caller's cgroup v2 group, from the "0::<path>" line of
+// /proc/self/cgroup
+std::optional<std::string> OwnCgroup() {
+  std::ifstream cgroup("/proc/self/cgroup");
+  std::string line;
+  while (std::getline(cgroup, line)) {
+    if (line.rfind("0::", 0) == 0) {
+      return line.substr(3);
+    }
+  }
+  errno = ENOENT;
+  return std::nullopt;
+}
+
+bool WriteFile(const std::string &path, const std::string &value) {
+  int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return false;
+  }
+  const bool written =
+      write(fd, value.data(), value.size()) ==
+      static_cast<ssize_t>(value.size());
+  const int error = errno;
+  close(fd);
+  errno = error;
+  return written;
+}
+} // namespace
+
+std::optional<std::string> CgroupFreezer::Create(const std::string &name) {
+  auto mount = Cgroup2Mount();
+  auto own = OwnCgroup();
+  if (!mount || !own) {
+    return std::nullopt;
+  }
+  std::string path = *mount + *own;
+  if (path.back() != '/') {
+    path += '/';
+  }
+  path += name;
+  if (mkdir(path.c_str(), 0755) == -1 && errno != EEXIST) {
+    return std::nullopt;
+  }
+  return path;
+}
+
+bool CgroupFreezer::Join(const std::string &path) {
+  // "0" stands for the writing process
+  return WriteFile(path + "/cgroup.procs", "0");
+}
+
+bool CgroupFreezer::Remove(const std::string &path) {
+  return rmdir(path.c_str()) == 0;
+}
+
+CgroupFreezer::CgroupFreezer(std::string path) : path_(std::move(path)) {}
+
+CgroupFreezer::~CgroupFreezer() {
+  if (freeze_fd_ != -1) {
+    close(freeze_fd_);
+  }
+  if (events_fd_ != -1) {
+    close(events_fd_);
+  }
+}
+
+bool CgroupFreezer::Open() {
+  if (freeze_fd_ == -1) {
+    freeze_fd_ =
+        open((path_ + "/cgroup.freeze").c_str(), O_WRONLY | O_CLOEXEC);
+  }
+  if (events_fd_ == -1) {
+    events_fd_ =
+        open((path_ + "/cgroup.events").c_str(), O_RDONLY | O_CLOEXEC);
+  }
+  return freeze_fd_ != -1 && events_fd_ != -1;
+}
+
+/**
+ * @brief Freezes the group and waits until all its tasks are stopped
+ *
+ * @details The kernel signals changes of cgroup.events as POLLPRI, so the
+ * wait sleeps instead of rereading the file in a loop.
+ */
+bool CgroupFreezer::Freeze() {
+  if (!Write('1')) {
+    return false;
+  }
+  const auto deadline = std::chrono::steady_clock::now() + kFreezeTimeout;
+  while (!IsFrozen()) {
+    const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now());
+    struct pollfd events = {events_fd_, POLLPRI, 0};
+    if (left.count() <= 0 ||
+        (poll(&events, 1, static_cast<int>(left.count())) == -1 &&
+         errno != EINTR)) {
+      const int error = left.count() <= 0 ? ETIMEDOUT : errno;
+      Write('0');
+      errno = error;
+      return false;
+    }
+  }
+  return true;
+}
+
+// Tasks run again as soon as the write returns
+bool CgroupFreezer::Thaw() { return Write('0'); }
+
+size_t CgroupFreezer::CountThreads() const {
+  std::ifstream threads(path_ + "/cgroup.threads");
+  std::string line;
+  size_t count = 0;
+  while (std::getline(threads, line)) {
+    count++;
+  }
+  return count;
+}
+
+bool CgroupFreezer::Write(char state) {
+  return pwrite(freeze_fd_, &state, 1, 0) == 1;
+}
+
+bool CgroupFreezer::IsFrozen() const {
+  char events[256];
+  const ssize_t size = pread(events_fd_, events, sizeof(events) - 1, 0);
+  if (size <= 0) {
+    return false;
+  }
+  events[size] = '\0';
+  return strstr(events, "frozen 1") != nullptr;
+}
+
+} // namespace memory_tools
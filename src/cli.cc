@@ -1,4 +1,5 @@
 #include "cli.hh"
+#include "placement.hh"
 #include "spdlog/sinks/basic_file_sink.h"
 #include "spdlog/sinks/stdout_color_sinks.h"
 #include "spdlog/spdlog.h"
@@ -46,6 +47,60 @@ void AddCommonOptions(CLI::App *app, CommonOptions &options) {
   app->add_option("--threads", options.num_threads, "Number of scanner threads")
       ->default_val(12)
       ->check(CLI::Range(1, 256));
+  app->add_option("--chunk-size", options.chunk_size,
+                  "Bytes each scanner thread reads at once (e.g. 1MiB-16MiB)")
+      ->default_val("4MiB")
+      ->transform(CLI::AsSizeValue(false))
+      ->check(CLI::Range(size_t{4096}, size_t{1} << 30));
+  app->add_option("--memory-backend", options.memory_backend,
+                  "Target memory access (auto, vm, procmem)")
+      ->transform(CLI::CheckedTransformer(
+          std::map<std::string, MemoryBackend>{
+              {"auto", MemoryBackend::Auto},
+              {"vm", MemoryBackend::ProcessVm},
+              {"procmem", MemoryBackend::ProcMem}},
+          CLI::ignore_case));
+  app->add_option("--stop-mode", options.stop_mode,
+                  "How the target is stopped for scans (attach = attach and "
+                  "detach each time, seize = stay seized and interrupt, "
+                  "group = seize and interrupt every thread, freeze = "
+                  "cgroup v2 freezer of a cgroup made for the target)")
+      ->transform(CLI::CheckedTransformer(
+          std::map<std::string, StopMode>{{"attach", StopMode::Attach},
+                                          {"seize", StopMode::Seize},
+                                          {"group", StopMode::Group},
+                                          {"freeze", StopMode::Freeze}},
+          CLI::ignore_case));
+  app->add_option("--scan-engine", options.scan_engine,
+                  "How scanner threads read memory (sync, io_uring, pipeline "
+                  "= (--threads - 1)/2 reader/classifier pairs + a writer, needs 3 "
+                  "threads)")
+      ->transform(CLI::CheckedTransformer(
+          std::map<std::string, ScanEngine>{{"sync", ScanEngine::Sync},
+                                            {"io_uring", ScanEngine::IoUring},
+                                            {"pipeline", ScanEngine::Pipeline}},
+          CLI::ignore_case));
+  app->add_option("--queue-depth", options.queue_depth,
+                  "Reads in flight per thread (io_uring) or buffers per "
+                  "reader (pipeline); each needs a --chunk-size buffer")
+      ->default_val(16)
+      ->check(CLI::Range(1, 4096));
+  app->add_flag("--skip-nonresident", options.skip_nonresident,
+                "Only scan pages that pagemap reports resident (skips "
+                "untouched, swapped-out and zero pages)");
+  app->add_option("--scan-cpus", options.scan_cpus,
+                  "Pin scanner threads round-robin to a CPU list (e.g. 0-3,8)")
+      ->check([](const std::string &list) {
+        std::vector<int> cpus;
+        return ParseCpuList(list, cpus) ? std::string{}
+                                        : "invalid CPU list: " + list;
+      });
+  app->add_flag("--avoid-target-cpus", options.avoid_target_cpus,
+                "Keep the scanner and monitor threads off the CPUs the "
+                "target may run on");
+  app->add_flag("--numa-buffers", options.numa_buffers,
+                "Allocate scan buffers on the NUMA node holding most of the "
+                "target's memory, and run there unless --scan-cpus is given");
 
   app->add_option("--log-level", options.log_level,
                   "Log level (trace, debug, info, warn, error, critical)")
@@ -80,11 +135,25 @@ void AddCommonOptions(CLI::App *app, CommonOptions &options) {
       ->default_val(0.)
       ->check(CLI::Range(0.0, 1.0));
 
+  app->add_option("--pointer-errors", options.pointer_errors,
+                  "Inject exactly this many pointer errors per scan, picked "
+                  "uniformly (overrides the error rates)")
+      ->default_val(0);
+
+  app->add_option("--non-pointer-errors", options.non_pointer_errors,
+                  "Inject exactly this many non-pointer errors per scan, "
+                  "picked uniformly (overrides the error rates)")
+      ->default_val(0);
+
   app->add_option("--error-limit", options.error_limit,
                   "Maximum number of errors to inject")
       ->default_val(std::numeric_limits<size_t>::max())
       ->check(CLI::PositiveNumber);
 
+  app->add_option("--inject-regions", options.inject_regions,
+                  "Only inject into regions whose name contains one of these "
+                  "strings, e.g. [heap] (default: all writable regions)");
+
   app->add_option("--error-seed", options.error_seed,
                   "RNG seed for error injection (0 for random)")
       ->default_val(0);
@@ -118,6 +187,20 @@ CliSubcommands CreateCli(CLI::App &app, RunPeriodicOptions &periodic_opts,
                    "Initial delay before first scan in milliseconds")
       ->default_val(1000)
       ->check(CLI::PositiveNumber);
+  auto incremental = run_periodic->add_flag(
+      "--incremental", periodic_opts.incremental,
+      "Only rescan pages written since the previous scan (soft-dirty)");
+  auto concurrent = run_periodic->add_flag(
+      "--concurrent", periodic_opts.concurrent,
+      "Count while the target runs and stop it only to rescan the pages it "
+      "wrote meanwhile (soft-dirty) and the ones holding injection sites");
+  run_periodic
+      ->add_flag("--snapshot", periodic_opts.snapshot,
+                 "Scan a copy-on-write fork of the target and stop it only to "
+                 "fork and to write the errors (x86-64; not with "
+                 "--stop-mode freeze)")
+      ->excludes(concurrent)
+      ->excludes(incremental);
 
   AddCommonOptions(run_cmd, cmd_opts);
   return CliSubcommands{run_once, run_periodic, run_cmd};
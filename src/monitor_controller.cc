@@ -1,6 +1,8 @@
 #include "monitor_controller.hh"
 #include "attach_guard.hh"
 #include "command_handler.hh"
+#include "placement.hh"
+#include <algorithm>
 #include <sys/wait.h>
 #include <thread>
 
@@ -9,11 +11,35 @@ namespace memory_tools {
 MonitorController::MonitorController(pid_t child_pid, const CommonOptions &opts,
                                      MonitorMode mode, MonitorConfig config)
     : process_manager_(child_pid), injection_strategy_(opts),
-      num_threads_(opts.num_threads), mode_(mode), config_(config) {}
+      scan_pool_(opts.num_threads), mode_(mode), config_(config) {
+  if (!opts.scan_cpus.empty()) {
+    ParseCpuList(opts.scan_cpus, placement_.cpus);
+  }
+  placement_.avoid_target_cpus = opts.avoid_target_cpus;
+  placement_.numa_buffers = opts.numa_buffers;
+  process_manager_.SetChunkSize(opts.chunk_size);
+  process_manager_.SetMemoryBackend(opts.memory_backend);
+  process_manager_.SetStopMode(opts.stop_mode);
+  if (!config.freeze_cgroup.empty()) {
+    process_manager_.SetFreezeCgroup(config.freeze_cgroup);
+  }
+  process_manager_.SetScanEngine(opts.scan_engine, opts.queue_depth);
+  process_manager_.SetSkipNonResident(opts.skip_nonresident);
+  process_manager_.SetIncremental(config_.incremental);
+}
 
 bool MonitorController::StartMonitoring() { return RunMonitorLoop(); }
 
 bool MonitorController::CheckChildRunning() {
+  // waitpid would report the stops of a seized target as well
+  if (!process_manager_.PollTarget()) {
+    spdlog::info("Child process terminated");
+    return false;
+  }
+  if (process_manager_.IsSeized()) {
+    return true;
+  }
+
   int status;
   if (pid_t result = waitpid(process_manager_.GetPid(), &status, WNOHANG);
       result == -1) {
@@ -27,6 +53,71 @@ bool MonitorController::CheckChildRunning() {
   }
 }
 
+std::optional<ScanStats> MonitorController::Scan(InjectionStrategy &strategy,
+                                                 ScanMethod method) {
+  if (!placed_) {
+    PlaceScanners();
+    placed_ = true;
+  }
+  switch (method) {
+  case ScanMethod::Stopped:
+    break;
+  case ScanMethod::Concurrent:
+    return process_manager_.ScanConcurrently(strategy, scan_pool_);
+  case ScanMethod::Snapshot:
+    return process_manager_.ScanSnapshot(strategy, scan_pool_);
+  }
+  return process_manager_.ScanForPointers(strategy, scan_pool_);
+}
+
+void MonitorController::PlaceScanners() {
+  const pid_t pid = process_manager_.GetPid();
+  std::vector<int> cpus = placement_.cpus;
+
+  if (placement_.numa_buffers) {
+    if (auto node = TargetMemoryNode(pid)) {
+      spdlog::info("Placing scan buffers on NUMA node {}", *node);
+      process_manager_.SetBufferNode(*node);
+      if (cpus.empty()) {
+        cpus = NodeCpus(*node);
+      }
+    } else {
+      spdlog::warn("No NUMA information for process {}", pid);
+    }
+  }
+
+  if (placement_.avoid_target_cpus) {
+    if (cpus.empty()) {
+      cpus = AllowedCpus();
+    }
+    std::vector<int> target_cpus = TargetCpus(pid);
+    std::vector<int> free_cpus;
+    std::set_difference(cpus.begin(), cpus.end(), target_cpus.begin(),
+                        target_cpus.end(), std::back_inserter(free_cpus));
+    if (free_cpus.empty()) {
+      spdlog::warn("Process {} may run on every scanner CPU; restrict it "
+                   "with taskset to keep the scanners off its cores",
+                   pid);
+    } else {
+      // This thread attaches, polls and writes back, so it stays off the
+      // target's cores as well
+      if (!RestrictThread(pthread_self(), free_cpus)) {
+        spdlog::warn("Failed to move the monitor thread off the target's "
+                     "CPUs: {}",
+                     strerror(errno));
+      }
+      cpus = std::move(free_cpus);
+    }
+  }
+
+  if (cpus.empty()) {
+    return;
+  }
+  if (!scan_pool_.Pin(cpus)) {
+    spdlog::warn("Failed to pin scanner threads: {}", strerror(errno));
+  }
+}
+
 bool MonitorController::RunMonitorLoop() {
   switch (mode_) {
   case MonitorMode::Periodic:
@@ -47,34 +138,53 @@ bool MonitorController::HandlePeriodicMode() {
 
   size_t iterations = 0;
   while (CheckChildRunning()) {
-    {
+    std::optional<ScanStats> stats;
+    if (config_.scan_method != ScanMethod::Stopped) {
+      stats = Scan(injection_strategy_, config_.scan_method);
+    } else {
       AttachGuard guard(process_manager_);
       if (!guard.Success()) {
         spdlog::error("Unable to attach to process {}",
                       process_manager_.GetPid());
         return false;
       }
-      auto stats =
-          process_manager_.ScanForPointers(injection_strategy_, num_threads_);
-      if (!stats.has_value()) {
-        return false;
-      }
+      stats = Scan(injection_strategy_);
+    }
+    if (!stats.has_value()) {
+      return false;
+    }
 
-      std::stringstream ss;
-      ss << stats.value();
-      spdlog::info(ss.str());
+    std::stringstream ss;
+    ss << stats.value();
+    spdlog::info(ss.str());
 
-      iterations++;
-      if (config_.iteration_limit && iterations >= *config_.iteration_limit) {
-        break;
-      }
+    iterations++;
+    if (config_.iteration_limit && iterations >= *config_.iteration_limit) {
+      break;
     }
 
-    std::this_thread::sleep_for(config_.interval);
+    Sleep(config_.interval);
   }
   return true;
 }
 
+// A seized target stops for every signal it gets until we forward it, so
+// long sleeps are cut into short polls
+void MonitorController::Sleep(std::chrono::milliseconds duration) {
+  constexpr std::chrono::milliseconds kPollInterval{10};
+  const auto end = std::chrono::steady_clock::now() + duration;
+  while (process_manager_.IsSeized() && process_manager_.PollTarget()) {
+    const auto now = std::chrono::steady_clock::now();
+    if (now >= end) {
+      return;
+    }
+    std::this_thread::sleep_for(
+        std::min<std::chrono::steady_clock::duration>(kPollInterval,
+                                                      end - now));
+  }
+  std::this_thread::sleep_until(end);
+}
+
 bool MonitorController::HandleCommandMode() {
   while (CheckChildRunning()) {
     if (IsCommandPending()) {
@@ -134,8 +244,7 @@ bool MonitorController::ProcessCommand() {
 }
 
 bool MonitorController::HandleScan() {
-  auto stats =
-      process_manager_.ScanForPointers(injection_strategy_, num_threads_);
+  auto stats = Scan(injection_strategy_);
   if (stats.has_value()) {
     std::stringstream ss;
     ss << stats.value();
@@ -158,7 +267,7 @@ bool MonitorController::HandleRestore() {
 
 bool MonitorController::HandleInjectErrors() {
   spdlog::info("Injecting errors (if applicable)");
-  process_manager_.ScanForPointers(injection_strategy_, num_threads_);
+  Scan(injection_strategy_);
   return true;
 }
 
@@ -0,0 +1,232 @@
+#include "pagemap.hh"
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// PAGEMAP_SCAN (Linux 6.7) is missing from older UAPI headers
+#ifndef PAGEMAP_SCAN
+struct page_region {
+  __u64 start;
+  __u64 end;
+  __u64 categories;
+};
+
+struct pm_scan_arg {
+  __u64 size;
+  __u64 flags;
+  __u64 start;
+  __u64 end;
+  __u64 walk_end;
+  __u64 vec;
+  __u64 vec_len;
+  __u64 max_pages;
+  __u64 category_inverted;
+  __u64 category_mask;
+  __u64 category_anyof_mask;
+  __u64 return_mask;
+};
+
+#define PAGEMAP_SCAN _IOWR('f', 16, struct pm_scan_arg)
+#endif
+
+namespace memory_tools {
+
+namespace {
+constexpr size_t kScanVecLen = 1024;
+constexpr uint64_t kScanCategories =
+    Pagemap::kIsFile | Pagemap::kIsPresent | Pagemap::kIsSwapped |
+    Pagemap::kIsPfnZero | Pagemap::kIsSoftDirty;
+
+uint64_t FindZeroPfn() {
+  const size_t page_size = static_cast<size_t>(getpagesize());
+  void *page = mmap(nullptr, page_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS,
+                    -1, 0);
+  if (page == MAP_FAILED) {
+    return 0;
+  }
+
+  // Reading an untouched anonymous page maps the shared zero page
+  (void)*static_cast<volatile const uint8_t *>(page);
+
+  uint64_t pfn = 0;
+  Pagemap self(getpid());
+  std::vector<uint64_t> entries;
+  uint64_t addr = reinterpret_cast<uint64_t>(page);
+  if (self.Open() && self.ReadEntries(addr, addr + page_size, entries) &&
+      (entries[0] & Pagemap::kPresent)) {
+    pfn = entries[0] & Pagemap::kPfnMask;
+  }
+  munmap(page, page_size);
+  return pfn;
+}
+
+bool ProbeSoftDirty() {
+  const size_t page_size = static_cast<size_t>(getpagesize());
+  void *page = mmap(nullptr, page_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (page == MAP_FAILED) {
+    return false;
+  }
+
+  // A freshly written page of a new mapping is always soft-dirty if the
+  // kernel tracks the bit at all
+  *static_cast<volatile uint8_t *>(page) = 1;
+
+  bool supported = false;
+  Pagemap self(getpid());
+  std::vector<uint64_t> entries;
+  uint64_t addr = reinterpret_cast<uint64_t>(page);
+  if (self.Open() && self.ReadEntries(addr, addr + page_size, entries)) {
+    supported = entries[0] & Pagemap::kSoftDirty;
+  }
+  munmap(page, page_size);
+  return supported;
+}
+} // namespace
+
+Pagemap::Pagemap(pid_t pid)
+    : pid_(pid), page_size_(static_cast<size_t>(getpagesize())) {}
+
+Pagemap::~Pagemap() {
+  if (fd_ != -1) {
+    close(fd_);
+  }
+}
+
+bool Pagemap::Open() {
+  if (fd_ != -1) {
+    return true;
+  }
+  std::string path = "/proc/" + std::to_string(pid_) + "/pagemap";
+  fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  return fd_ != -1;
+}
+
+bool Pagemap::ReadEntries(uint64_t start_addr, uint64_t end_addr,
+                          std::vector<uint64_t> &entries) const {
+  const size_t count = (end_addr - start_addr) / page_size_;
+  entries.resize(count);
+
+  const size_t bytes = count * sizeof(uint64_t);
+  const off_t offset =
+      static_cast<off_t>(start_addr / page_size_ * sizeof(uint64_t));
+  size_t done = 0;
+  while (done < bytes) {
+    ssize_t ret = pread(fd_, reinterpret_cast<uint8_t *>(entries.data()) + done,
+                        bytes - done, offset + static_cast<off_t>(done));
+    if (ret <= 0) {
+      return false;
+    }
+    done += static_cast<size_t>(ret);
+  }
+  return true;
+}
+
+/**
+ * @brief Runs PAGEMAP_SCAN over [start_addr, end_addr)
+ *
+ * No category filter is set, so every page of the range is reported and the
+ * kernel merges neighbours with equal categories into one run. The walk is
+ * resumed from walk_end whenever the output vector fills up.
+ */
+bool Pagemap::ScanIoctl(uint64_t start_addr, uint64_t end_addr,
+                        std::vector<CategoryRun> &runs) const {
+  std::vector<struct page_region> regions(kScanVecLen);
+  struct pm_scan_arg arg = {};
+  arg.size = sizeof(arg);
+  arg.vec = reinterpret_cast<uint64_t>(regions.data());
+  arg.vec_len = regions.size();
+  arg.return_mask = kScanCategories;
+
+  uint64_t addr = start_addr;
+  while (addr < end_addr) {
+    arg.start = addr;
+    arg.end = end_addr;
+    int count = ioctl(fd_, PAGEMAP_SCAN, &arg);
+    if (count < 0) {
+      return false;
+    }
+    for (int i = 0; i < count; i++) {
+      const auto &region = regions[static_cast<size_t>(i)];
+      runs.push_back({region.start, region.end, region.categories});
+    }
+    if (arg.walk_end <= addr) {
+      break;
+    }
+    addr = arg.walk_end;
+  }
+  return true;
+}
+
+bool Pagemap::ReadCategories(uint64_t start_addr, uint64_t end_addr,
+                             std::vector<CategoryRun> &runs) {
+  if (use_scan_ioctl_) {
+    size_t first = runs.size();
+    if (ScanIoctl(start_addr, end_addr, runs)) {
+      return true;
+    }
+    runs.resize(first);
+    if (errno != ENOTTY && errno != EINVAL) {
+      return false;
+    }
+    // Kernel predates PAGEMAP_SCAN; stick to reading entries
+    use_scan_ioctl_ = false;
+  }
+
+  if (!ReadEntries(start_addr, end_addr, entries_)) {
+    return false;
+  }
+  uint64_t addr = start_addr;
+  for (uint64_t entry : entries_) {
+    uint64_t categories = EntryCategories(entry);
+    if (!runs.empty() && runs.back().end_addr == addr &&
+        runs.back().categories == categories) {
+      runs.back().end_addr += page_size_;
+    } else {
+      runs.push_back({addr, addr + page_size_, categories});
+    }
+    addr += page_size_;
+  }
+  return true;
+}
+
+bool Pagemap::IsResident(uint64_t categories) {
+  return (categories & kIsPresent) && !(categories & kIsPfnZero);
+}
+
+uint64_t Pagemap::EntryCategories(uint64_t entry) {
+  uint64_t categories = 0;
+  if (entry & kPresent) {
+    categories |= kIsPresent;
+    const uint64_t zero_pfn = ZeroPfn();
+    if (zero_pfn != 0 && (entry & kPfnMask) == zero_pfn) {
+      categories |= kIsPfnZero;
+    }
+  }
+  if (entry & kSwapped) {
+    categories |= kIsSwapped;
+  }
+  if (entry & kFilePage) {
+    categories |= kIsFile;
+  }
+  if (entry & kSoftDirty) {
+    categories |= kIsSoftDirty;
+  }
+  return categories;
+}
+
+uint64_t Pagemap::ZeroPfn() {
+  static const uint64_t zero_pfn = FindZeroPfn();
+  return zero_pfn;
+}
+
+bool Pagemap::SoftDirtySupported() {
+  static const bool supported = ProbeSoftDirty();
+  return supported;
+}
+
+} // namespace memory_tools
@@ -0,0 +1,200 @@
+#include "placement.hh"
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <dirent.h>
+#include <fstream>
+#include <linux/mempolicy.h>
+#include <map>
+#include <sched.h>
+#include <sstream>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace memory_tools {
+
+namespace {
+constexpr size_t kMaxNodes = 1024;
+
+std::vector<int> CpusOf(const cpu_set_t &set) {
+  std::vector<int> cpus;
+  for (size_t cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &set)) {
+      cpus.push_back(static_cast<int>(cpu));
+    }
+  }
+  return cpus;
+}
+
+bool ParseInt(const std::string &text, int &value) {
+  const char *end = text.data() + text.size();
+  auto [ptr, ec] = std::from_chars(text.data(), end, value);
+  return ec == std::errc() && ptr == end;
+}
+} // namespace
+
+bool ParseCpuList(const std::string &list, std::vector<int> &cpus) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+
+  std::istringstream iss(list);
+  std::string token;
+  while (std::getline(iss, token, ',')) {
+    size_t dash_pos = token.find('-');
+    int first;
+    int last;
+    if (dash_pos == std::string::npos) {
+      if (!ParseInt(token, first)) {
+        return false;
+      }
+      last = first;
+    } else if (!ParseInt(token.substr(0, dash_pos), first) ||
+               !ParseInt(token.substr(dash_pos + 1), last)) {
+      return false;
+    }
+    if (first < 0 || last < first || last >= CPU_SETSIZE) {
+      return false;
+    }
+    for (auto cpu = static_cast<size_t>(first);
+         cpu <= static_cast<size_t>(last); cpu++) {
+      CPU_SET(cpu, &set);
+    }
+  }
+
+  cpus = CpusOf(set);
+  return !cpus.empty();
+}
+
+std::vector<int> AllowedCpus() {
+  cpu_set_t set;
+  if (sched_getaffinity(0, sizeof(set), &set) == -1) {
+    return {};
+  }
+  return CpusOf(set);
+}
+
+std::vector<int> TargetCpus(pid_t pid) {
+  cpu_set_t all;
+  CPU_ZERO(&all);
+
+  std::string task_path = "/proc/" + std::to_string(pid) + "/task";
+  DIR *dir = opendir(task_path.c_str());
+  if (dir == nullptr) {
+    return {};
+  }
+  while (struct dirent *entry = readdir(dir)) {
+    int tid;
+    if (!ParseInt(entry->d_name, tid)) {
+      continue;
+    }
+    cpu_set_t set;
+    if (sched_getaffinity(tid, sizeof(set), &set) == 0) {
+      CPU_OR(&all, &all, &set);
+    }
+  }
+  closedir(dir);
+  return CpusOf(all);
+}
+
+std::vector<int> NodeCpus(int node) {
+  std::ifstream cpulist("/sys/devices/system/node/node" +
+                        std::to_string(node) + "/cpulist");
+  std::string list;
+  std::vector<int> cpus;
+  if (!std::getline(cpulist, list) || !ParseCpuList(list, cpus)) {
+    return {};
+  }
+  return cpus;
+}
+
+/**
+ * @brief Finds the node with the most target pages
+ *
+ * Every numa_maps line lists the pages of one mapping per node as
+ * "N<node>=<pages>". Reading the file walks the target's page tables, so
+ * this is meant to be called once, not per scan.
+ */
+std::optional<int> TargetMemoryNode(pid_t pid) {
+  std::ifstream numa_maps("/proc/" + std::to_string(pid) + "/numa_maps");
+  if (!numa_maps) {
+    return std::nullopt;
+  }
+
+  std::map<int, uint64_t> pages_per_node;
+  std::string line;
+  while (std::getline(numa_maps, line)) {
+    std::istringstream iss(line);
+    std::string field;
+    while (iss >> field) {
+      size_t eq_pos = field.find('=');
+      int node;
+      uint64_t pages;
+      if (field.size() < 2 || field[0] != 'N' || eq_pos == std::string::npos ||
+          !ParseInt(field.substr(1, eq_pos - 1), node)) {
+        continue;
+      }
+      const char *value = field.data() + eq_pos + 1;
+      const char *end = field.data() + field.size();
+      if (std::from_chars(value, end, pages).ec == std::errc()) {
+        pages_per_node[node] += pages;
+      }
+    }
+  }
+
+  std::optional<int> best;
+  uint64_t best_pages = 0;
+  for (const auto &[node, pages] : pages_per_node) {
+    if (pages > best_pages) {
+      best = node;
+      best_pages = pages;
+    }
+  }
+  return best;
+}
+
+bool PinThread(pthread_t thread, int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(static_cast<size_t>(cpu), &set);
+  return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
+
+bool RestrictThread(pthread_t thread, const std::vector<int> &cpus) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus) {
+    CPU_SET(static_cast<size_t>(cpu), &set);
+  }
+  if (cpus.empty()) {
+    errno = EINVAL;
+    return false;
+  }
+  // Reports the error instead of setting errno
+  errno = pthread_setaffinity_np(thread, sizeof(set), &set);
+  return errno == 0;
+}
+
+bool BindToNode(void *addr, size_t size, int node) {
+  if (node < 0 || static_cast<size_t>(node) >= kMaxNodes) {
+    return false;
+  }
+
+  // mbind needs a page aligned start; partial pages at the ends stay put
+  const auto page_size = static_cast<uintptr_t>(getpagesize());
+  const auto begin = reinterpret_cast<uintptr_t>(addr);
+  const uintptr_t start = (begin + page_size - 1) & ~(page_size - 1);
+  const uintptr_t end = (begin + size) & ~(page_size - 1);
+  if (start >= end) {
+    return true;
+  }
+
+  constexpr size_t kBitsPerWord = 8 * sizeof(unsigned long);
+  unsigned long nodemask[kMaxNodes / kBitsPerWord] = {};
+  const auto bit = static_cast<size_t>(node);
+  nodemask[bit / kBitsPerWord] |= 1UL << (bit % kBitsPerWord);
+  // The kernel reads maxnode - 1 bits
+  return syscall(SYS_mbind, start, end - start, MPOL_BIND, nodemask,
+                 kMaxNodes + 1, MPOL_MF_MOVE) == 0;
+}
+
+} // namespace memory_tools
@@ -1,22 +1,155 @@
 #include "process_manager.hh"
+#include "cgroup_freezer.hh"
+#include "counter_rng.hh"
+#include "error_injection.hh"
 #include "injection_strategy.hh"
+#include "io_uring.hh"
+#include "pagemap.hh"
+#include "placement.hh"
+#include "spsc_ring.hh"
+#include "thread_pool.hh"
+#include "word_classifier.hh"
 #include "spdlog/spdlog.h"
 #include <algorithm>
+#include <bit>
+#include <climits>
+#include <condition_variable>
 #include <criu/criu.h>
+#include <csignal>
 #include <cstring>
+#include <dirent.h>
+#include <exception>
 #include <fcntl.h>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <sched.h>
 #include <sstream>
 #include <stdexcept>
+#include <thread>
+#include <unordered_set>
 #include <sys/ptrace.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/uio.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
 namespace memory_tools {
 
+namespace {
+constexpr size_t kDefaultChunkSize = 4 * 1024 * 1024;
+constexpr unsigned kDefaultQueueDepth = 16;
+// Page cache entry for pages that have to be read on the next scan
+constexpr uint16_t kUncached = std::numeric_limits<uint16_t>::max();
+// How often a seized target is polled while it runs during a scan
+constexpr std::chrono::milliseconds kPollInterval{10};
+
+// ptrace takes the signal to deliver in its data argument
+void *SignalArg(int signal) {
+  return reinterpret_cast<void *>(static_cast<intptr_t>(signal));
+}
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Threads of `pid` according to /proc/<pid>/task
+std::vector<pid_t> ListThreads(pid_t pid) {
+  std::vector<pid_t> tids;
+  std::string task_path = "/proc/" + std::to_string(pid) + "/task";
+  DIR *dir = opendir(task_path.c_str());
+  if (dir == nullptr) {
+    return tids;
+  }
+  while (struct dirent *entry = readdir(dir)) {
+    char *end;
+    const long tid = strtol(entry->d_name, &end, 10);
+    if (*end == '\0' && tid > 0) {
+      tids.push_back(static_cast<pid_t>(tid));
+    }
+  }
+  closedir(dir);
+  return tids;
+}
+
+// Parent of `pid` according to /proc/<pid>/stat, whose second field is the
+// command name in parentheses and may itself contain them
+pid_t ParentOf(pid_t pid) {
+  std::ifstream stat("/proc/" + std::to_string(pid) + "/stat");
+  std::string line;
+  if (!std::getline(stat, line)) {
+    return -1;
+  }
+  const size_t name_end = line.rfind(')');
+  if (name_end == std::string::npos) {
+    return -1;
+  }
+  std::istringstream fields(line.substr(name_end + 1));
+  char state;
+  pid_t parent;
+  return fields >> state >> parent ? parent : -1;
+}
+
+// Signals the thread group of `pid` ignores, from the SigIgn line of
+// /proc/<pid>/status; bit n - 1 stands for signal n
+std::optional<uint64_t> IgnoredSignals(pid_t pid) {
+  std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.rfind("SigIgn:", 0) == 0) {
+      return std::stoull(line.substr(7), nullptr, 16);
+    }
+  }
+  return {};
+}
+
+// Counting pass of exact-count injection: adds up the words of every block
+class WordCounter final : public InjectionStrategy {
+public:
+  WordCounter(const MemoryRegion *regions, std::vector<RegionStats> &stats)
+      : regions_(regions), stats_(stats) {}
+
+  uint64_t HandleBatch(uint64_t addr, std::span<uint64_t> words,
+                       uint64_t pointer_mask, bool /* writable */,
+                       const MemoryRegion &region) override {
+    auto &region_stats = stats_[static_cast<size_t>(&region - regions_)];
+    const size_t block = (addr - region_stats.region_start) /
+                         ProcessManager::kCountBlockSize;
+    // Work units split regions at arbitrary pages, so several scanner
+    // threads can add to one block
+    std::atomic_ref<uint32_t>(region_stats.block_pointers[block])
+        .fetch_add(static_cast<uint32_t>(std::popcount(pointer_mask)),
+                   std::memory_order_relaxed);
+    std::atomic_ref<uint32_t>(region_stats.block_words[block])
+        .fetch_add(static_cast<uint32_t>(words.size()),
+                   std::memory_order_relaxed);
+    return 0;
+  }
+
+private:
+  const MemoryRegion *regions_;
+  std::vector<RegionStats> &stats_;
+};
+
+// Picks `count` distinct numbers below `total` uniformly (Floyd's algorithm)
+std::vector<uint64_t> PickOrdinals(uint64_t total, uint64_t count,
+                                   uint64_t key) {
+  count = std::min(count, total);
+  std::unordered_set<uint64_t> picked;
+  for (uint64_t j = total - count; j < total; j++) {
+    const uint64_t t = CounterRng::Draw(key, j) % (j + 1);
+    picked.insert(picked.contains(t) ? j : t);
+  }
+  std::vector<uint64_t> ordinals(picked.begin(), picked.end());
+  std::sort(ordinals.begin(), ordinals.end());
+  return ordinals;
+}
+} // namespace
+
 bool MemoryRegion::operator<(const MemoryRegion &other) const {
   return start_addr < other.start_addr;
 }
@@ -25,26 +158,81 @@ bool MemoryRegion::contains(uintptr_t addr) const {
   return addr >= start_addr && addr < end_addr;
 }
 
+bool RegionFilter::Matches(const MemoryRegion &region) const {
+  if (writable_only && !region.is_writable) {
+    return false;
+  }
+
+  const std::string &name = region.mapping_name;
+  const unsigned kind = name.find("[heap]") != std::string::npos ? kHeap
+                        : name.find("[stack]") != std::string::npos
+                            ? kStack
+                            : kStatic;
+  if ((kinds & kind) == 0) {
+    return false;
+  }
+
+  // Unnamed mappings keep the whitespace that ends their maps line
+  const size_t name_start = name.find_first_not_of(" \t");
+  const bool anonymous =
+      name_start == std::string::npos || name[name_start] == '[';
+  if ((backing == Backing::Anonymous && !anonymous) ||
+      (backing == Backing::File && anonymous)) {
+    return false;
+  }
+
+  return name_patterns.empty() ||
+         std::any_of(name_patterns.begin(), name_patterns.end(),
+                     [&](const std::string &pattern) {
+                       return name.find(pattern) != std::string::npos;
+                     });
+}
+
 ProcessManager::ProcessManager(pid_t target_pid)
     : target_pid_(target_pid), is_attached_(false),
-      page_size_(static_cast<size_t>(getpagesize())) {
+      page_size_(static_cast<size_t>(getpagesize())),
+      chunk_size_(kDefaultChunkSize), backend_(MemoryBackend::Auto),
+      engine_(ScanEngine::Sync), queue_depth_(kDefaultQueueDepth),
+      skip_nonresident_(false), incremental_(false),
+      mem_fd_(-1), use_proc_mem_(false), address_map_(page_size_) {
   if (target_pid_ <= 0) {
     throw std::invalid_argument("Invalid process ID");
   }
 }
 
 ProcessManager::~ProcessManager() {
-  if (is_attached_) {
+  if (snapshot_) {
+    // A fork snapshot must never run, so it is killed instead of detached
+    kill(target_pid_, SIGKILL);
+    waitpid(target_pid_, nullptr, __WALL);
+    is_attached_ = false;
+  }
+  if (is_seized_) {
+    Release();
+  } else if (is_attached_) {
     Detach();
   }
+  if (mem_fd_ != -1) {
+    close(mem_fd_);
+  }
 }
 
 bool ProcessManager::Attach() {
   if (is_attached_) {
     return true; // Already attached
   }
+  switch (stop_mode_) {
+  case StopMode::Attach:
+    break;
+  case StopMode::Seize:
+  case StopMode::Group:
+    return Interrupt();
+  case StopMode::Freeze:
+    return FreezeCgroup();
+  }
   spdlog::info("Attaching Process");
 
+  stop_requested_ = std::chrono::steady_clock::now();
   if (ptrace(PTRACE_ATTACH, target_pid_, nullptr, nullptr) == -1) {
     std::cerr << "Failed to attach to process " << target_pid_ << ": "
               << strerror(errno) << std::endl;
@@ -87,16 +275,347 @@ bool ProcessManager::Attach() {
     }
   }
 
+  freeze_ms_ = MillisecondsSince(stop_requested_);
+  threads_stopped_ = 1;
   is_attached_ = true;
+  OpenMemFile();
   return RefreshMemoryMap();
 }
 
+void ProcessManager::OpenMemFile() {
+  if (backend_ != MemoryBackend::ProcessVm) {
+    std::string mem_path = "/proc/" + std::to_string(target_pid_) + "/mem";
+    mem_fd_ = open(mem_path.c_str(), O_RDWR | O_CLOEXEC);
+    if (mem_fd_ == -1) {
+      spdlog::warn("Failed to open {}: {}", mem_path, strerror(errno));
+    }
+  }
+  use_proc_mem_ = backend_ == MemoryBackend::ProcMem && mem_fd_ != -1;
+}
+
+/**
+ * @brief Stops a seized target, seizing it on first use
+ *
+ * @details Seizing and opening /proc/<pid>/mem happen once. The memory map
+ * is read while the target still runs, so neither is part of the stop.
+ * Mappings created after the read are picked up at the next stop, and
+ * reads of ranges unmapped in between fail like any unreadable range.
+ */
+bool ProcessManager::Interrupt() {
+  if (!is_seized_) {
+    spdlog::info("Seizing process");
+    if (!SeizeThreads()) {
+      return false;
+    }
+    OpenMemFile();
+  }
+
+  if (!RefreshMemoryMap()) {
+    return false;
+  }
+
+  stop_requested_ = std::chrono::steady_clock::now();
+  if (!StopThreads()) {
+    return false;
+  }
+  freeze_ms_ = MillisecondsSince(stop_requested_);
+  threads_stopped_ = threads_.size();
+  is_attached_ = true;
+  return true;
+}
+
+bool ProcessManager::SetFreezeCgroup(const std::string &path) {
+  freezer_ = std::make_unique<CgroupFreezer>(path);
+  if (!freezer_->Open()) {
+    spdlog::error("Failed to open freezer of cgroup {}: {}", path,
+                  strerror(errno));
+    freezer_.reset();
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Stops the target by freezing its cgroup
+ *
+ * @details One write stops every thread and child process of the target,
+ * however many there are. Nothing is traced: memory is read and written
+ * with the access a parent has to its child. As in StopMode::Seize, the
+ * memory map is read before the stop and /proc/<pid>/mem stays open between
+ * scans.
+ */
+bool ProcessManager::FreezeCgroup() {
+  if (!freezer_) {
+    spdlog::error("No cgroup to freeze process {} in", target_pid_);
+    return false;
+  }
+  if (mem_fd_ == -1) {
+    OpenMemFile();
+  }
+  if (!RefreshMemoryMap()) {
+    return false;
+  }
+
+  stop_requested_ = std::chrono::steady_clock::now();
+  if (!freezer_->Freeze()) {
+    spdlog::error("Failed to freeze cgroup {}: {}", freezer_->Path(),
+                  strerror(errno));
+    return false;
+  }
+  freeze_ms_ = MillisecondsSince(stop_requested_);
+  threads_stopped_ = freezer_->CountThreads();
+  is_attached_ = true;
+  return true;
+}
+
+/**
+ * @brief Seizes the target, or in StopMode::Group every thread of it
+ *
+ * @details In StopMode::Group, seized threads report their clones and the
+ * new threads are traced from their first instruction. A thread that is not
+ * seized yet can still clone unnoticed, so the task list is read again until
+ * it holds nothing new. Threads that cannot be seized because a clone
+ * already traced them are added when their parent reports the clone.
+ */
+bool ProcessManager::SeizeThreads() {
+  const bool group = stop_mode_ == StopMode::Group;
+  void *options = reinterpret_cast<void *>(
+      static_cast<intptr_t>(group ? PTRACE_O_TRACECLONE : 0));
+  for (bool found = true; found;) {
+    found = false;
+    const std::vector<pid_t> tids =
+        group ? ListThreads(target_pid_) : std::vector<pid_t>{target_pid_};
+    for (pid_t tid : tids) {
+      if (threads_.count(tid) != 0) {
+        continue;
+      }
+      if (ptrace(PTRACE_SEIZE, tid, nullptr, options) == -1) {
+        if (tid != target_pid_) {
+          continue;
+        }
+        spdlog::error("Failed to seize process {}: {}", target_pid_,
+                      strerror(errno));
+        break;
+      }
+      threads_.try_emplace(tid);
+      found = true;
+    }
+  }
+  // Threads seized before a failure are let go by Release
+  is_seized_ = !threads_.empty();
+  if (threads_.count(target_pid_) == 0) {
+    return false;
+  }
+  spdlog::info("Seized {} thread(s)", threads_.size());
+  return true;
+}
+
+/**
+ * @brief Interrupts every traced thread and waits until all are stopped
+ *
+ * All threads are asked before waiting for any, so their stops overlap
+ * instead of adding up.
+ */
+bool ProcessManager::StopThreads() {
+  for (const auto &[tid, thread] : threads_) {
+    if (!thread.stopped &&
+        ptrace(PTRACE_INTERRUPT, tid, nullptr, nullptr) == -1 &&
+        errno != ESRCH) {
+      spdlog::error("Failed to interrupt thread {}: {}", tid,
+                    strerror(errno));
+      return false;
+    }
+  }
+  return WaitForStops();
+}
+
+/**
+ * @brief Waits until every traced thread sits in an interrupt or job control
+ * stop
+ *
+ * Threads that stop for something else first are resumed and interrupted
+ * again. Clones add their new threads, which start out stopped, and threads
+ * that exit meanwhile are dropped.
+ */
+bool ProcessManager::WaitForStops() {
+  for (;;) {
+    auto it = std::find_if(threads_.begin(), threads_.end(),
+                           [](const auto &entry) {
+                             return !entry.second.stopped;
+                           });
+    if (it == threads_.end()) {
+      return true;
+    }
+    const pid_t tid = it->first;
+    int status;
+    if (waitpid(tid, &status, __WALL) == -1) {
+      spdlog::error("Failed to wait for thread {}: {}", tid, strerror(errno));
+      return false;
+    }
+    HandleThreadStatus(tid, status, true);
+    if (exited_) {
+      spdlog::info("Process {} exited while stopping it", target_pid_);
+      return false;
+    }
+  }
+}
+
+/**
+ * @brief Acts on a wait status of a traced thread
+ *
+ * @details Signal-delivery stops are resumed with their signal, and clone
+ * events after tracing the new thread. While `stopping`, those threads are
+ * interrupted again and interrupt stops mark the thread stopped. Otherwise
+ * the target is meant to run: a new thread's first stop is resumed and job
+ * control stops wait for SIGCONT like an untraced process would. Returns
+ * false once the thread is gone.
+ */
+bool ProcessManager::HandleThreadStatus(pid_t tid, int status, bool stopping) {
+  if (!WIFSTOPPED(status)) {
+    if (tid == target_pid_) {
+      // The leader is reaped after all other threads
+      threads_.clear();
+      is_seized_ = false;
+      exited_ = true;
+    } else {
+      threads_.erase(tid);
+    }
+    return false;
+  }
+
+  TracedThread &thread = threads_[tid];
+  const int event = status >> 16;
+  if (event == PTRACE_EVENT_STOP) {
+    // SIGTRAP marks an interrupt; other signals a job control stop
+    thread.group_stopped = WSTOPSIG(status) != SIGTRAP;
+    if (stopping) {
+      thread.stopped = true;
+    } else {
+      const auto request = thread.group_stopped ? PTRACE_LISTEN : PTRACE_CONT;
+      ptrace(request, tid, nullptr, nullptr);
+    }
+    return true;
+  }
+
+  if (event != PTRACE_EVENT_CLONE) {
+    ptrace(PTRACE_CONT, tid, nullptr, SignalArg(WSTOPSIG(status)));
+    if (stopping) {
+      ptrace(PTRACE_INTERRUPT, tid, nullptr, nullptr);
+    }
+    return true;
+  }
+
+  unsigned long message;
+  const bool traced =
+      ptrace(PTRACE_GETEVENTMSG, tid, nullptr, &message) == 0 &&
+      threads_.try_emplace(static_cast<pid_t>(message)).second;
+  ptrace(PTRACE_CONT, tid, nullptr, nullptr);
+  if (stopping) {
+    ptrace(PTRACE_INTERRUPT, tid, nullptr, nullptr);
+  } else if (traced) {
+    // The new thread is about to stop; let it go without waiting for a poll
+    const auto child = static_cast<pid_t>(message);
+    int child_status;
+    if (waitpid(child, &child_status, __WALL) == child) {
+      HandleThreadStatus(child, child_status, false);
+    }
+  }
+  return true;
+}
+
+bool ProcessManager::PollTarget() {
+  if (exited_) {
+    return false;
+  }
+  if (!is_seized_ || is_attached_) {
+    return true;
+  }
+
+  for (auto it = threads_.begin(); it != threads_.end();) {
+    // Handling a status may drop this thread or add new ones
+    const pid_t tid = (it++)->first;
+    int status;
+    pid_t result;
+    do {
+      result = waitpid(tid, &status, WNOHANG | __WALL);
+    } while (result > 0 && HandleThreadStatus(tid, status, false));
+    if (exited_ || (result == -1 && tid == target_pid_)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ProcessManager::Release() {
+  if (!is_seized_) {
+    return true;
+  }
+  // PTRACE_DETACH needs stopped tracees
+  if (!is_attached_ && !StopThreads()) {
+    return false;
+  }
+
+  spdlog::info("Releasing process");
+  if (mem_fd_ != -1) {
+    close(mem_fd_);
+    mem_fd_ = -1;
+  }
+  bool released = true;
+  for (const auto &entry : threads_) {
+    if (ptrace(PTRACE_DETACH, entry.first, nullptr, nullptr) == -1 &&
+        errno != ESRCH) {
+      spdlog::error("Failed to detach from thread {}: {}", entry.first,
+                    strerror(errno));
+      released = false;
+    }
+  }
+  threads_.clear();
+  is_seized_ = false;
+  is_attached_ = false;
+  return released;
+}
+
 bool ProcessManager::Detach() {
   if (!is_attached_) {
     return true; // Already detached
   }
 
+  if (stop_mode_ == StopMode::Freeze) {
+    const auto start = std::chrono::steady_clock::now();
+    if (!freezer_->Thaw()) {
+      spdlog::error("Failed to thaw cgroup {}: {}", freezer_->Path(),
+                    strerror(errno));
+      return false;
+    }
+    is_attached_ = false;
+    spdlog::info("Thawed {} thread(s) in {:.3f} ms", threads_stopped_,
+                 MillisecondsSince(start));
+    return true;
+  }
+
+  if (is_seized_) {
+    const auto start = std::chrono::steady_clock::now();
+    bool resumed = true;
+    for (auto &[tid, thread] : threads_) {
+      // A job control stop must outlast the scan
+      const auto request = thread.group_stopped ? PTRACE_LISTEN : PTRACE_CONT;
+      if (ptrace(request, tid, nullptr, nullptr) == -1 && errno != ESRCH) {
+        spdlog::error("Failed to resume thread {}: {}", tid, strerror(errno));
+        resumed = false;
+      }
+      thread.stopped = false;
+    }
+    is_attached_ = false;
+    spdlog::info("Resumed {} thread(s) in {:.3f} ms", threads_.size(),
+                 MillisecondsSince(start));
+    return resumed;
+  }
+
   spdlog::info("Detaching process");
+  if (mem_fd_ != -1) {
+    close(mem_fd_);
+    mem_fd_ = -1;
+  }
   if (ptrace(PTRACE_DETACH, target_pid_, nullptr, nullptr) == -1) {
     std::cerr << "Failed to detach from process " << target_pid_ << ": "
               << strerror(errno) << std::endl;
@@ -113,19 +632,30 @@ bool ProcessManager::ReadMemory(uint64_t addr, void *buffer,
     return false;
   }
 
-  struct iovec local_iov = {.iov_base = buffer, .iov_len = size};
+  if (!UseProcMem()) {
+    struct iovec local_iov = {.iov_base = buffer, .iov_len = size};
 
-  struct iovec remote_iov = {.iov_base = reinterpret_cast<void *>(addr),
-                             .iov_len = size};
+    struct iovec remote_iov = {.iov_base = reinterpret_cast<void *>(addr),
+                               .iov_len = size};
 
-  // Try process_vm_readv first
-  ssize_t read_bytes =
-      process_vm_readv(target_pid_, &local_iov, 1, &remote_iov, 1, 0);
-  if (read_bytes != -1) {
-    return static_cast<size_t>(read_bytes) == size;
+    // Try process_vm_readv first
+    ssize_t read_bytes =
+        process_vm_readv(target_pid_, &local_iov, 1, &remote_iov, 1, 0);
+    if (read_bytes != -1) {
+      return static_cast<size_t>(read_bytes) == size;
+    }
+  }
+
+  // /proc/<pid>/mem reads with ptrace force access, so it also reaches
+  // mappings without read permission
+  if (mem_fd_ != -1) {
+    ssize_t read_bytes = pread(mem_fd_, buffer, size, static_cast<off_t>(addr));
+    if (read_bytes != -1) {
+      return static_cast<size_t>(read_bytes) == size;
+    }
   }
 
-  // Fall back to ptrace if process_vm_readv fails
+  // Fall back to ptrace if neither bulk interface works
   long *ptr = reinterpret_cast<long *>(buffer);
   size_t words = (size + sizeof(long) - 1) / sizeof(long);
 
@@ -145,8 +675,8 @@ bool ProcessManager::ReadMemory(uint64_t addr, void *buffer,
  * @brief Writes data to target process memory
  *
  * Attempts to write data to the target process memory using process_vm_writev,
- * falling back to ptrace if that fails. The function ensures atomic writes
- * as much as possible to maintain memory consistency.
+ * falling back to /proc/<pid>/mem and then ptrace if that fails. The function
+ * ensures atomic writes as much as possible to maintain memory consistency.
  *
  * @param addr The target address in the remote process to write to
  * @param buffer Pointer to the local buffer containing data to write
@@ -154,36 +684,57 @@ bool ProcessManager::ReadMemory(uint64_t addr, void *buffer,
  *
  * @return true if the write was successful, false otherwise
  *
- * @note This function requires the process to be attached and the target
- *       memory region to be writable
+ * @note This function requires the process to be attached. The target memory
+ *       region only needs to be writable if /proc/<pid>/mem is unavailable
  */
 bool ProcessManager::WriteMemory(uint64_t addr, const void *buffer,
                                  size_t size) const {
   if (!is_attached_) {
     return false;
   }
+  if (snapshot_) {
+    return LogSnapshotWrite(addr, buffer, size);
+  }
 
-  // Setup the local and remote IOVs for process_vm_writev
-  struct iovec local_iov = {.iov_base = const_cast<void *>(
-                                buffer), // process_vm_writev requires non-const
-                            .iov_len = size};
-
-  struct iovec remote_iov = {.iov_base = reinterpret_cast<void *>(addr),
-                             .iov_len = size};
+  if (!UseProcMem()) {
+    // Setup the local and remote IOVs for process_vm_writev
+    struct iovec local_iov = {
+        .iov_base =
+            const_cast<void *>(buffer), // process_vm_writev requires non-const
+        .iov_len = size};
+
+    struct iovec remote_iov = {.iov_base = reinterpret_cast<void *>(addr),
+                               .iov_len = size};
+
+    // Try process_vm_writev first as it's more efficient
+    ssize_t written_bytes =
+        process_vm_writev(target_pid_, &local_iov, 1, &remote_iov, 1, 0);
+    if (written_bytes != -1) {
+      if (static_cast<size_t>(written_bytes) == size) {
+        return true;
+      }
+      spdlog::error("Partial write via process_vm_writev: {} of {} bytes",
+                    written_bytes, size);
+      return false;
+    }
+  }
 
-  // Try process_vm_writev first as it's more efficient
-  ssize_t written_bytes =
-      process_vm_writev(target_pid_, &local_iov, 1, &remote_iov, 1, 0);
-  if (written_bytes != -1) {
-    if (static_cast<size_t>(written_bytes) == size) {
-      return true;
+  // /proc/<pid>/mem writes with ptrace force access, so read-only mappings
+  // can be modified as well (private mappings are copied on write)
+  if (mem_fd_ != -1) {
+    ssize_t written_bytes =
+        pwrite(mem_fd_, buffer, size, static_cast<off_t>(addr));
+    if (written_bytes != -1) {
+      if (static_cast<size_t>(written_bytes) == size) {
+        return true;
+      }
+      spdlog::error("Partial write via /proc/{}/mem: {} of {} bytes",
+                    target_pid_, written_bytes, size);
+      return false;
     }
-    spdlog::error("Partial write via process_vm_writev: {} of {} bytes",
-                  written_bytes, size);
-    return false;
   }
 
-  // Fall back to ptrace if process_vm_writev fails
+  // Fall back to ptrace if neither bulk interface works
   const long *ptr = reinterpret_cast<const long *>(buffer);
   size_t words = (size + sizeof(long) - 1) / sizeof(long);
 
@@ -228,6 +779,15 @@ bool ProcessManager::WriteMemory(uint64_t addr, const void *buffer,
   return true;
 }
 
+void ProcessManager::SetChunkSize(size_t chunk_size) {
+  chunk_size_ = std::max(page_size_, chunk_size - chunk_size % page_size_);
+}
+
+void ProcessManager::SetScanEngine(ScanEngine engine, unsigned queue_depth) {
+  engine_ = engine;
+  queue_depth_ = std::max(1U, queue_depth);
+}
+
 bool ProcessManager::RefreshMemoryMap() {
   std::string maps_path = "/proc/" + std::to_string(target_pid_) + "/maps";
   std::ifstream maps(maps_path);
@@ -237,8 +797,10 @@ bool ProcessManager::RefreshMemoryMap() {
     return false;
   }
 
+  // Kept to tell whether the address map needs a rebuild
+  std::vector<MemoryRegion> previous_regions;
+  previous_regions.swap(all_regions_);
   readable_regions_.clear();
-  all_regions_.clear();
 
   std::string line;
   while (std::getline(maps, line)) {
@@ -294,19 +856,42 @@ bool ProcessManager::RefreshMemoryMap() {
   std::sort(all_regions_.begin(), all_regions_.end());
   std::sort(readable_regions_.begin(), readable_regions_.end());
 
+  // Every stop refreshes the map, but the mappings rarely change between
+  // scans. The address map only depends on the region bounds.
+  const bool unchanged = std::equal(
+      all_regions_.begin(), all_regions_.end(), previous_regions.begin(),
+      previous_regions.end(), [](const auto &region, const auto &previous) {
+        return region.start_addr == previous.start_addr &&
+               region.end_addr == previous.end_addr;
+      });
+  if (!unchanged) {
+    address_map_.Clear();
+    for (const auto &region : all_regions_) {
+      address_map_.Add(region.start_addr, region.end_addr);
+    }
+  }
+
   return !all_regions_.empty();
 }
 
 bool ProcessManager::IsValidPointerTarget(uint64_t addr) const {
-  // Do binary search on sorted target_regions_.
-  auto it = std::upper_bound(all_regions_.begin(), all_regions_.end(), addr,
-                             [](uint64_t addr_, const MemoryRegion &region) {
-                               return addr_ < region.start_addr;
-                             });
-  if (it == all_regions_.begin())
-    return false;
-  --it;
-  return addr >= it->start_addr && addr < it->end_addr;
+  return address_map_.Contains(addr);
+}
+
+// Bit i is set if word i of `data` points into a mapping. Only words passing
+// the vectorized pre-filter need an address map lookup.
+uint64_t ProcessManager::PointerMask(const uint8_t *data, size_t words) const {
+  uint64_t pointers = 0;
+  for (uint64_t candidates = CandidateMask(data, words); candidates != 0;
+       candidates &= candidates - 1) {
+    const auto word = static_cast<unsigned>(std::countr_zero(candidates));
+    uint64_t value;
+    std::memcpy(&value, data + word * sizeof(uint64_t), sizeof(value));
+    if (IsValidPointerTarget(value)) {
+      pointers |= 1ULL << word;
+    }
+  }
+  return pointers;
 }
 
 bool ProcessManager::IsLikelyPointer(uint64_t value) const {
@@ -336,11 +921,10 @@ bool ProcessManager::CreateCheckpoint() {
   std::string checkpoint_dir = CheckpointDir();
   int dir_fd;
 
-  if (attached) {
-    if (!Detach()) {
-      spdlog::error("Failed to detach from process before checkpoint");
-      goto done;
-    }
+  // CRIU traces the target itself, so a seized target is let go entirely
+  if (is_seized_ ? !Release() : attached && !Detach()) {
+    spdlog::error("Failed to detach from process before checkpoint");
+    goto done;
   }
 
   // Create (if needed) directory, allocate file descriptor
@@ -412,12 +996,9 @@ bool ProcessManager::RestoreCheckpoint() {
     goto done;
   }
 
-  if (attached) {
-    if (!Detach()) {
-      spdlog::error(
-          "Failed to detach from process before restoring checkpoint");
-      goto done;
-    }
+  if (is_seized_ ? !Release() : attached && !Detach()) {
+    spdlog::error("Failed to detach from process before restoring checkpoint");
+    goto done;
   }
 
   if (dir_fd = open(checkpoint_dir.c_str(), O_DIRECTORY); dir_fd < 0) {
@@ -453,6 +1034,27 @@ done:
 std::optional<ScanStats>
 ProcessManager::ScanForPointers(InjectionStrategy &strategy,
                                 size_t num_threads_) {
+  ThreadPool pool(num_threads_);
+  return ScanForPointers(strategy, pool);
+}
+
+std::optional<ScanStats>
+ProcessManager::ScanForPointers(InjectionStrategy &strategy,
+                                ThreadPool &pool) {
+  return ScanAttached(strategy, pool, false);
+}
+
+/**
+ * @brief Scans the stopped target
+ *
+ * @details With `clean_pages`, a rate-based strategy is also offered the
+ * pages an incremental scan reuses from the page cache, see
+ * InjectCleanPages. Exact-count strategies get them through InjectSites
+ * either way.
+ */
+std::optional<ScanStats>
+ProcessManager::ScanAttached(InjectionStrategy &strategy, ThreadPool &pool,
+                             bool clean_pages) {
   if (!IsAttached()) {
     throw std::runtime_error("Not attached to target process");
   }
@@ -463,48 +1065,69 @@ ProcessManager::ScanForPointers(InjectionStrategy &strategy,
 
   auto start_time = std::chrono::steady_clock::now();
   ScanStats stats;
-  strategy.PreRunner();
-
-  // Divide regions among threads
-  const auto &regions = readable_regions_;
-  std::vector<std::vector<const MemoryRegion *>> thread_regions(num_threads_);
-  for (size_t i = 0; i < regions.size(); i++) {
-    thread_regions[i % num_threads_].push_back(&regions[i]);
-  }
-
-  // Create per-thread stats and syncrhonization
-  std::vector<ScanStats> thread_stats(num_threads_);
-
-  // Launch threads
-  std::vector<std::thread> threads;
-  for (size_t thread_id = 0; thread_id < num_threads_; ++thread_id) {
-    threads.emplace_back(
-        [this, thread_id, &thread_regions, &thread_stats, &strategy]() {
-          for (const MemoryRegion *region : thread_regions[thread_id]) {
-            ScanRegion(*region, strategy, thread_stats[thread_id]);
-            thread_stats[thread_id].regions_scanned++;
-          }
-        });
+  // A saturated strategy changes nothing, so the maps and pagemap are not
+  // even read. Soft-dirty bits stay set for the next scan that reads.
+  if (strategy.Saturated()) {
+    spdlog::debug("Strategy saturated, skipping the scan");
+    stats.stopped_early = true;
+    strategy.PostRunner();
+    return stats;
   }
-
-  // Wait for all threads
-  for (auto &thread : threads) {
-    thread.join();
+  spdlog::debug("Classifying words with the {} kernel",
+                ClassifierKernelName());
+
+  // In exact-count mode the full pass only counts words, and the strategy
+  // sees just the words picked afterwards. Incremental scans take the counts
+  // from the page cache, which also covers the pages they do not read.
+  const SiteRequest request = strategy.Sites();
+  const bool exact = request.pointers != 0 || request.non_pointers != 0;
+  clean_pages = clean_pages && incremental_ && !exact &&
+                strategy.Callbacks() != 0;
+
+  std::vector<ScanRange> ranges;
+  std::vector<ScanRange> clean;
+  if (!BuildWorkList(strategy.Regions(), ranges, stats,
+                     clean_pages ? &clean : nullptr)) {
+    return {};
   }
 
-  // Merge stats
-  for (const auto &thread_stat : thread_stats) {
-    stats.total_bytes_scanned += thread_stat.total_bytes_scanned;
-    stats.bytes_readable += thread_stat.bytes_readable;
-    stats.bytes_writable += thread_stat.bytes_writable;
-    stats.bytes_executable += thread_stat.bytes_executable;
-    stats.bytes_skipped += thread_stat.bytes_skipped;
-    stats.pointers_found += thread_stat.pointers_found;
-    stats.regions_scanned += thread_stat.regions_scanned;
+  std::vector<RegionStats> region_stats;
+  if (exact) {
+    region_stats = NewRegionStats();
+  }
+  WordCounter counter(readable_regions_.data(), region_stats);
+  ScanOnlyStrategy cache_counter;
+  InjectionStrategy &pass_strategy =
+      !exact         ? strategy
+      : incremental_ ? static_cast<InjectionStrategy &>(cache_counter)
+                     : static_cast<InjectionStrategy &>(counter);
+  chunk_kernel_ = SelectChunkKernel(pass_strategy);
+
+  stats.stop_to_read_ms = MillisecondsSince(stop_requested_);
+  stats.freeze_ms = freeze_ms_;
+  stats.threads_stopped = threads_stopped_;
+  RunScanPass(pass_strategy, pool, ranges, stats);
+  if (exact) {
+    if (incremental_) {
+      CountCachedWords(region_stats);
+    }
+    InjectSites(strategy, pool, request, ranges, region_stats);
+  } else if (!clean.empty() && !scan_stopped_.load(std::memory_order_relaxed)) {
+    InjectCleanPages(strategy, pool, clean);
+  }
+  stats.stopped_early = scan_stopped_.load(std::memory_order_relaxed);
+  if (stats.stopped_early) {
+    spdlog::debug("Strategy saturated, stopped scanning early");
   }
 
   strategy.PostRunner();
 
+  // Pages left unread keep their soft-dirty bits so the next scan reads them
+  // instead of reusing stale counts
+  if (incremental_ && !stats.stopped_early) {
+    ClearSoftDirty();
+  }
+
   auto end_time = std::chrono::steady_clock::now();
   stats.scan_time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
                            end_time - start_time)
@@ -512,69 +1135,1796 @@ ProcessManager::ScanForPointers(InjectionStrategy &strategy,
   return stats;
 }
 
-void ProcessManager::ScanRegion(const MemoryRegion &region,
-                                InjectionStrategy &strategy,
-                                ScanStats &local_stats) {
-  std::vector<uint8_t> buffer(page_size_);
-  uint64_t current_addr = region.start_addr;
-
-  while (current_addr < region.end_addr) {
-    size_t remaining = region.end_addr - current_addr;
-    size_t to_read = std::min(remaining, page_size_);
-
-    if (!ReadMemory(current_addr, buffer.data(), to_read)) {
-      local_stats.bytes_skipped += to_read;
-    } else {
-      bool write_back = false;
-
-      for (size_t offset = 0; offset + sizeof(uint64_t) <= to_read;
-           offset += sizeof(uint64_t)) {
-        uint64_t value;
-        std::memcpy(&value, buffer.data() + offset, sizeof(uint64_t));
-
-        bool modified = false;
-        if (IsLikelyPointer(value)) {
-          modified = strategy.HandlePointer(current_addr + offset, value,
-                                            region.is_writable, region);
-          local_stats.pointers_found++;
-        } else {
-          modified = strategy.HandleNonPointer(current_addr + offset, value,
-                                               region.is_writable, region);
-        }
-
-        if (modified) {
-          write_back = true;
-          std::memcpy(buffer.data() + offset, &value, sizeof(value));
-        }
-      }
-
-      local_stats.total_bytes_scanned += to_read;
-      local_stats.bytes_readable += to_read;
-      if (region.is_writable) {
-        local_stats.bytes_writable += to_read;
-      }
-      if (region.is_executable) {
-        local_stats.bytes_executable += to_read;
-      }
-
-      if (write_back && region.is_writable) {
-        WriteMemory(current_addr, buffer.data(), to_read);
-      }
+/**
+ * @brief Scans mostly while the target runs, like the concurrent marking of
+ * a garbage collector
+ *
+ * @details The soft-dirty bits are cleared first. A counting pass then reads
+ * every page into the incremental page cache while the target runs; it never
+ * writes. Any page the target writes after the clear is soft-dirty when it
+ * is stopped, so the final incremental pass, the only one the strategy takes
+ * part in, rereads just those pages and the ones the counting pass could not
+ * read. The strategy's sites on the other pages are reached by rereading
+ * only the pages holding them, so a rate-based strategy still samples all
+ * of memory. A seized target is polled throughout the counting pass.
+ */
+std::optional<ScanStats>
+ProcessManager::ScanConcurrently(InjectionStrategy &strategy,
+                                 ThreadPool &pool) {
+  if (IsAttached()) {
+    throw std::runtime_error("Target must run during a concurrent scan");
+  }
+  if (!Pagemap::SoftDirtySupported()) {
+    spdlog::warn("Kernel does not track soft-dirty pages; stopping the "
+                 "target for the whole scan");
+    if (!Attach()) {
+      return {};
     }
-    current_addr += to_read;
+    auto stats = ScanForPointers(strategy, pool);
+    Detach();
+    return stats;
+  }
+  // Incremental mode only lasts for this call
+  struct RestoreIncremental {
+    bool &incremental;
+    bool saved;
+    ~RestoreIncremental() { incremental = saved; }
+  } restore{incremental_, incremental_};
+  incremental_ = true;
+
+  const auto start = std::chrono::steady_clock::now();
+  const bool open_mem = mem_fd_ == -1;
+  if (open_mem) {
+    OpenMemFile();
+  }
+  ScanStats concurrent;
+  ScanOnlyStrategy counter;
+  std::vector<ScanRange> ranges;
+  // Counts cached by the previous scan may be stale for pages written
+  // before the clear, so every page is read again
+  page_cache_.clear();
+  bool counted = RefreshMemoryMap() && ClearSoftDirty() &&
+                 BuildWorkList(strategy.Regions(), ranges, concurrent);
+  if (counted) {
+    chunk_kernel_ = SelectChunkKernel(counter);
+    PollDuring([&] { RunScanPass(counter, pool, ranges, concurrent); });
+  }
+  if (open_mem && mem_fd_ != -1) {
+    close(mem_fd_);
+    mem_fd_ = -1;
+  }
+  if (!counted) {
+    return {};
+  }
+  const double concurrent_ms = MillisecondsSince(start);
+
+  const auto stop_start = std::chrono::steady_clock::now();
+  if (!Attach()) {
+    return {};
   }
+  auto stats = ScanAttached(strategy, pool, true);
+  Detach();
+  if (stats) {
+    stats->concurrent_ms = concurrent_ms;
+    stats->concurrent_bytes = concurrent.total_bytes_scanned;
+    stats->stopped_ms = MillisecondsSince(stop_start);
+  }
+  return stats;
 }
 
-std::ostream &operator<<(std::ostream &os, const ScanStats &stats) {
-  double percent =
-      100. * (sizeof(uintptr_t) * static_cast<double>(stats.pointers_found)) /
-      static_cast<double>(stats.bytes_readable - stats.bytes_executable);
-  os << "Scan Statistics:\n"
-     << std::dec << "  Regions scanned:         " << stats.regions_scanned
-     << "\n"
-     << "  Total bytes scanned:     " << stats.total_bytes_scanned << " ("
-     << (static_cast<double>(stats.total_bytes_scanned) / (1024.0 * 1024.0))
-     << " MB)\n"
+/**
+ * @brief Scans a copy-on-write fork of the target while the target runs
+ *
+ * @details The target is stopped only while ForkTarget makes it fork. The
+ * fork never runs, so its memory stays as it was at that moment however long
+ * the scan takes, and the kernel only copies the pages the target writes
+ * meanwhile. A second ProcessManager scans the fork with this one's settings
+ * and scan buffers and logs every word the strategy changes instead of
+ * writing it. The fork is then killed, and a second short stop writes the
+ * logged words to the target, skipping those the target changed since the
+ * fork. The strategy's own log still lists the skipped ones. A seized target
+ * is polled throughout the scan. If the target cannot be forked, it stays
+ * stopped for a normal scan instead.
+ */
+std::optional<ScanStats>
+ProcessManager::ScanSnapshot(InjectionStrategy &strategy, ThreadPool &pool) {
+  if (IsAttached()) {
+    throw std::runtime_error("Target must run during a snapshot scan");
+  }
+  const auto stop_start = std::chrono::steady_clock::now();
+  if (!Attach()) {
+    return {};
+  }
+  const pid_t fork_pid = ForkTarget();
+  if (fork_pid == -1) {
+    spdlog::warn("Could not fork a snapshot; stopping the target for the "
+                 "whole scan");
+    auto stats = ScanForPointers(strategy, pool);
+    Detach();
+    return stats;
+  }
+  const double freeze_ms = freeze_ms_;
+  const size_t threads_stopped = threads_stopped_;
+  Detach();
+  double stopped_ms = MillisecondsSince(stop_start);
+
+  std::optional<ScanStats> stats;
+  std::vector<SnapshotWrite> writes;
+  {
+    ProcessManager snapshot(fork_pid);
+    snapshot.snapshot_ = true;
+    snapshot.is_attached_ = true; // Stopped by ForkTarget
+    snapshot.chunk_size_ = chunk_size_;
+    snapshot.backend_ = backend_;
+    snapshot.engine_ = engine_;
+    snapshot.queue_depth_ = queue_depth_;
+    snapshot.skip_nonresident_ = skip_nonresident_;
+    snapshot.buffer_node_ = buffer_node_;
+    snapshot.scan_buffers_.swap(scan_buffers_);
+    snapshot.OpenMemFile();
+    if (snapshot.RefreshMemoryMap()) {
+      snapshot.stop_requested_ = std::chrono::steady_clock::now();
+      PollDuring([&] { stats = snapshot.ScanForPointers(strategy, pool); });
+    }
+    snapshot.scan_buffers_.swap(scan_buffers_);
+    writes = std::move(snapshot.snapshot_writes_);
+  }
+  if (!stats) {
+    return stats;
+  }
+
+  uint64_t skipped = 0;
+  if (!writes.empty()) {
+    const auto write_start = std::chrono::steady_clock::now();
+    if (!Attach()) {
+      return {};
+    }
+    for (const auto &write : writes) {
+      uint64_t current;
+      if (!ReadMemory(write.addr, &current, sizeof(current)) ||
+          current != write.original ||
+          !WriteMemory(write.addr, &write.value, sizeof(write.value))) {
+        skipped++;
+      }
+    }
+    Detach();
+    stopped_ms += MillisecondsSince(write_start);
+    if (skipped > 0) {
+      spdlog::info("Skipped {} of {} write(s) to words changed since the "
+                   "snapshot",
+                   skipped, writes.size());
+    }
+  }
+  stats->freeze_ms = freeze_ms;
+  stats->threads_stopped = threads_stopped;
+  stats->stopped_ms = stopped_ms;
+  stats->snapshot = true;
+  stats->writes_skipped = skipped;
+  return stats;
+}
+
+/**
+ * @brief Makes the stopped target fork a copy of itself that never runs
+ *
+ * @details The target's main thread executes clone(CLONE_PARENT |
+ * CLONE_FILES) from a syscall instruction already in its code, so no code is
+ * patched, with the registers restored afterwards. CLONE_PARENT makes the
+ * copy our child rather than the target's, so that we reap it and the
+ * target never sees it exit; that needs the target to be our child as well.
+ * CLONE_FILES shares the target's file table, so the copy holds no extra
+ * references that would keep sockets, pipes or locks the target closes
+ * meanwhile open until the end of the scan. Its zero exit signal
+ * makes ptrace report the call as PTRACE_EVENT_CLONE, after which the copy
+ * is traced and stopped before its first instruction. orig_rax = -1 keeps
+ * the kernel from restarting a system call the target was interrupted in
+ * during the step; restoring the registers restarts it as usual. Signals
+ * other than SIGTRAP are blocked for the step, so pending ones stay queued
+ * as they were, with their siginfo and whether they were sent to the
+ * process or the thread. The step itself is reported through a forced
+ * SIGTRAP, and forcing a blocked or ignored signal resets its handler to
+ * SIG_DFL, so SIGTRAP stays unblocked and a target that ignores it is not
+ * forked. A queued SIGTRAP is told apart from the step by its si_code, and
+ * like a SIGSTOP, the one signal that cannot be blocked, it is sent again
+ * after the step.
+ *
+ * @return The copy's process ID, or -1 if the target cannot be forked
+ */
+pid_t ProcessManager::ForkTarget() {
+#if defined(__x86_64__)
+  if (stop_mode_ == StopMode::Freeze) {
+    spdlog::error("Forking the target needs ptrace, not the cgroup freezer");
+    return -1;
+  }
+  if (ParentOf(target_pid_) != getpid()) {
+    spdlog::error("Process {} is not our child, so its fork could not be "
+                  "reaped",
+                  target_pid_);
+    return -1;
+  }
+  if (is_seized_ && threads_[target_pid_].group_stopped) {
+    // Stepping would end the job control stop
+    return -1;
+  }
+  const auto ignored = IgnoredSignals(target_pid_);
+  if (!ignored) {
+    spdlog::error("Failed to read the ignored signals of process {}",
+                  target_pid_);
+    return -1;
+  }
+  if ((*ignored >> (SIGTRAP - 1)) & 1) {
+    spdlog::error("Process {} ignores SIGTRAP, which stepping it would reset",
+                  target_pid_);
+    return -1;
+  }
+  const uint64_t syscall_addr = FindSyscallInstruction();
+  if (syscall_addr == 0) {
+    spdlog::error("No syscall instruction found in process {}", target_pid_);
+    return -1;
+  }
+
+  struct user_regs_struct saved;
+  if (ptrace(PTRACE_GETREGS, target_pid_, nullptr, &saved) == -1) {
+    spdlog::error("Failed to read registers of process {}: {}", target_pid_,
+                  strerror(errno));
+    return -1;
+  }
+  const long options = stop_mode_ == StopMode::Group ? PTRACE_O_TRACECLONE : 0;
+  struct user_regs_struct regs = saved;
+  regs.rip = syscall_addr;
+  regs.rax = SYS_clone;
+  regs.orig_rax = ~0ULL;
+  regs.rdi = CLONE_PARENT | CLONE_FILES; // Flags, with exit signal 0
+  regs.rsi = 0;                          // Stack: the caller's
+  regs.rdx = 0;
+  regs.r10 = 0;
+  regs.r8 = 0;
+  uint64_t saved_mask;
+  uint64_t blocked = ~(1ULL << (SIGTRAP - 1));
+  if (ptrace(PTRACE_GETSIGMASK, target_pid_, sizeof(saved_mask),
+             &saved_mask) == -1) {
+    spdlog::error("Failed to read signal mask of process {}: {}",
+                  target_pid_, strerror(errno));
+    return -1;
+  }
+  pid_t fork_pid = -1;
+  bool stop_deferred = false;
+  std::optional<siginfo_t> trap_deferred;
+  if (ptrace(PTRACE_SETOPTIONS, target_pid_, nullptr,
+             reinterpret_cast<void *>(options | PTRACE_O_TRACECLONE)) != -1 &&
+      ptrace(PTRACE_SETSIGMASK, target_pid_, sizeof(blocked), &blocked) !=
+          -1 &&
+      ptrace(PTRACE_SETREGS, target_pid_, nullptr, &regs) != -1) {
+    while (ptrace(PTRACE_SINGLESTEP, target_pid_, nullptr, nullptr) != -1) {
+      int status;
+      if (waitpid(target_pid_, &status, __WALL) == -1 || !WIFSTOPPED(status)) {
+        spdlog::error("Process {} ended while forking", target_pid_);
+        return -1;
+      }
+      if (status >> 16 == PTRACE_EVENT_CLONE) {
+        unsigned long message;
+        if (ptrace(PTRACE_GETEVENTMSG, target_pid_, nullptr, &message) != -1) {
+          fork_pid = static_cast<pid_t>(message);
+        }
+      } else if (WSTOPSIG(status) == SIGTRAP) {
+        siginfo_t info;
+        if (ptrace(PTRACE_GETSIGINFO, target_pid_, nullptr, &info) == -1 ||
+            info.si_code == TRAP_BRKPT || info.si_code == TRAP_TRACE) {
+          break; // Stepped over the syscall instruction
+        }
+        trap_deferred = info; // Queued before the step
+      } else if (WSTOPSIG(status) == SIGSTOP) {
+        stop_deferred = true; // The one signal that cannot be blocked
+      }
+    }
+  }
+  if (fork_pid == -1) {
+    spdlog::error("Failed to fork process {}: {}", target_pid_,
+                  strerror(errno));
+  }
+  ptrace(PTRACE_SETREGS, target_pid_, nullptr, &saved);
+  ptrace(PTRACE_SETSIGMASK, target_pid_, sizeof(saved_mask), &saved_mask);
+  ptrace(PTRACE_SETOPTIONS, target_pid_, nullptr,
+         reinterpret_cast<void *>(options));
+  if (stop_deferred) {
+    kill(target_pid_, SIGSTOP);
+  }
+  if (trap_deferred) {
+    if (trap_deferred->si_code == SI_TKILL) {
+      syscall(SYS_tgkill, target_pid_, target_pid_, SIGTRAP);
+    } else {
+      kill(target_pid_, SIGTRAP);
+    }
+  }
+  if (fork_pid == -1) {
+    return -1;
+  }
+  // Should we end during the scan, the kernel kills the fork instead of
+  // releasing it to run on as a second copy of the target
+  if (waitpid(fork_pid, nullptr, __WALL) == -1 ||
+      ptrace(PTRACE_SETOPTIONS, fork_pid, nullptr,
+             reinterpret_cast<void *>(PTRACE_O_EXITKILL)) == -1) {
+    spdlog::error("Failed to take over fork {} of process {}: {}", fork_pid,
+                  target_pid_, strerror(errno));
+    kill(fork_pid, SIGKILL);
+    waitpid(fork_pid, nullptr, __WALL);
+    return -1;
+  }
+  return fork_pid;
+#else
+  spdlog::error("Forking the target is only implemented for x86-64");
+  return -1;
+#endif
+}
+
+// Address of a syscall instruction (0f 05) in the target's code, looked for
+// in [vdso] first as it is small and always mapped; 0 if there is none
+uint64_t ProcessManager::FindSyscallInstruction() const {
+  std::vector<const MemoryRegion *> code;
+  for (const auto &region : all_regions_) {
+    if (region.is_readable && region.is_executable) {
+      code.push_back(&region);
+    }
+  }
+  std::stable_partition(code.begin(), code.end(), [](const auto *region) {
+    return region->mapping_name == "[vdso]";
+  });
+  std::vector<uint8_t> buffer(std::min(chunk_size_, kDefaultChunkSize));
+  for (const auto *region : code) {
+    // Chunks overlap by a byte so that no instruction is split
+    for (uint64_t addr = region->start_addr; addr + 1 < region->end_addr;
+         addr += buffer.size() - 1) {
+      const size_t size = static_cast<size_t>(
+          std::min<uint64_t>(buffer.size(), region->end_addr - addr));
+      if (!ReadMemory(addr, buffer.data(), size)) {
+        break;
+      }
+      for (size_t i = 0; i + 1 < size; i++) {
+        if (buffer[i] == 0x0f && buffer[i + 1] == 0x05) {
+          return addr + i;
+        }
+      }
+    }
+  }
+  return 0;
+}
+
+// Stands in for WriteMemory in a fork snapshot: records each changed word
+// with its value in the snapshot, which is never modified
+bool ProcessManager::LogSnapshotWrite(uint64_t addr, const void *buffer,
+                                      size_t size) const {
+  if (size % sizeof(uint64_t) != 0) {
+    spdlog::error("Snapshot writes must be whole words, not {} bytes", size);
+    return false;
+  }
+  std::vector<uint64_t> original(size / sizeof(uint64_t));
+  if (!ReadMemory(addr, original.data(), size)) {
+    return false;
+  }
+  const auto *values = static_cast<const uint8_t *>(buffer);
+  std::lock_guard<std::mutex> lock(snapshot_mutex_);
+  for (size_t i = 0; i < original.size(); i++) {
+    uint64_t value;
+    memcpy(&value, values + i * sizeof(value), sizeof(value));
+    snapshot_writes_.push_back(
+        {addr + i * sizeof(value), original[i], value});
+  }
+  return true;
+}
+
+/**
+ * @brief Runs `pass` on a helper thread while this one, the tracer, polls
+ * the running target
+ *
+ * @details A seized target stops for every signal, and in StopMode::Group
+ * every thread that clones stops as well, until the tracer handles the stop.
+ * Only the thread that seized the target can, so it keeps calling PollTarget
+ * until the pass is done instead of running the pass itself.
+ */
+void ProcessManager::PollDuring(const std::function<void()> &pass) {
+  if (!is_seized_ || is_attached_) {
+    pass();
+    return;
+  }
+  std::mutex mutex;
+  std::condition_variable finished;
+  bool done = false;
+  std::exception_ptr error;
+  std::thread runner([&] {
+    try {
+      pass();
+    } catch (...) {
+      error = std::current_exception();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    done = true;
+    finished.notify_one();
+  });
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!finished.wait_for(lock, kPollInterval, [&] { return done; })) {
+    lock.unlock();
+    PollTarget();
+    lock.lock();
+  }
+  lock.unlock();
+  runner.join();
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+/**
+ * @brief Checks between chunks whether the strategy is done with the scan
+ *
+ * The first thread to see the strategy saturated latches it, so the others
+ * stop at their next check without asking the strategy again.
+ */
+bool ProcessManager::ScanStopped(const InjectionStrategy &strategy) {
+  if (scan_stopped_.load(std::memory_order_relaxed)) {
+    return true;
+  }
+  if (strategy.Saturated()) {
+    scan_stopped_.store(true, std::memory_order_relaxed);
+    return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Reads and classifies all ranges once on the configured engine
+ *
+ * Stops early, leaving the rest of the ranges unread, once the strategy
+ * reports that it is saturated.
+ */
+void ProcessManager::RunScanPass(InjectionStrategy &strategy, ThreadPool &pool,
+                                 const std::vector<ScanRange> &ranges,
+                                 ScanStats &stats) {
+  scan_stopped_.store(false, std::memory_order_relaxed);
+  bool use_pipeline = engine_ == ScanEngine::Pipeline;
+  if (use_pipeline && pool.Size() < 3) {
+    spdlog::warn("Pipeline scan engine needs at least 3 scanner threads, "
+                 "using sync reads");
+    use_pipeline = false;
+  }
+  if (use_pipeline) {
+    // The pipeline engine pairs every reader with a classifier, each on a
+    // pool thread of its own, and leaves one thread for the write-back
+    // stage. Spreading work units over the lanes keeps a big region from
+    // landing on a single reader.
+    const size_t lanes = (pool.Size() - 1) / 2;
+    std::vector<std::vector<ScanRange>> lane_ranges(lanes);
+    auto units = SplitWorkUnits(ranges, chunk_size_);
+    for (size_t i = 0; i < units.size(); i++) {
+      lane_ranges[i % lanes].insert(lane_ranges[i % lanes].end(),
+                                    units[i].begin(), units[i].end());
+    }
+    ScanPipeline(pool, lane_ranges, strategy, stats);
+  } else {
+    bool use_io_uring = engine_ == ScanEngine::IoUring;
+    ReapStuckRings();
+    if (use_io_uring && stuck_rings_.size() >= kMaxStuckRings) {
+      spdlog::warn("{} io_uring rings still have reads in flight, using sync "
+                   "reads",
+                   stuck_rings_.size());
+      use_io_uring = false;
+    } else if (use_io_uring && (mem_fd_ == -1 || !IoUring::Supported())) {
+      spdlog::warn("io_uring scan engine unavailable ({}), using sync reads",
+                   mem_fd_ == -1 ? "no /proc/pid/mem"
+                                 : "io_uring_setup failed");
+      use_io_uring = false;
+    }
+
+    // Scan buffers outlive the scan so repeated scans don't reallocate them.
+    // The io_uring engine needs one chunk per in-flight read, and a work unit
+    // fills the whole buffer so the queue can be kept full.
+    const size_t buffer_size =
+        use_io_uring ? chunk_size_ * queue_depth_ : chunk_size_;
+    PrepareScanBuffers(pool.Size(), buffer_size);
+    const auto units = SplitWorkUnits(ranges, buffer_size);
+
+    std::vector<ScanStats> thread_stats(pool.Size());
+    std::vector<std::unique_ptr<IoUring>> rings(pool.Size());
+    pool.Run(units.size(), [&](size_t worker, size_t unit) {
+      if (ScanStopped(strategy)) {
+        pool.Cancel();
+        return;
+      }
+      auto &buffer = scan_buffers_[worker];
+      if (use_io_uring) {
+        if (!rings[worker]) {
+          rings[worker] = std::make_unique<IoUring>();
+          if (!rings[worker]->Init(queue_depth_)) {
+            spdlog::warn("io_uring failed on scanner thread {}: {}", worker,
+                         strerror(errno));
+          }
+        }
+        if (rings[worker]->IsInitialized()) {
+          ScanStats unit_stats;
+          if (ScanRegionsAsync(units[unit], buffer, rings[worker], strategy,
+                               unit_stats)) {
+            thread_stats[worker].Merge(unit_stats);
+            return;
+          }
+          spdlog::warn("io_uring failed on scanner thread {}: {}", worker,
+                       strerror(errno));
+          rings[worker] = std::make_unique<IoUring>();
+        }
+      }
+      ScanRegions(units[unit], buffer, strategy, thread_stats[worker]);
+    });
+
+    // Merge stats
+    for (const auto &thread_stat : thread_stats) {
+      stats.Merge(thread_stat);
+    }
+  }
+  for (const auto &time : pool.LastRunTimes()) {
+    stats.thread_busy_ms.push_back(
+        std::chrono::duration<double, std::milli>(time.busy).count());
+    stats.thread_idle_ms.push_back(
+        std::chrono::duration<double, std::milli>(time.idle).count());
+  }
+}
+
+/**
+ * @brief Offers a rate-based strategy the pages reused from the page cache
+ *
+ * @details Asks NextSite for the strategy's sites among the clean pages and
+ * rereads only the pages holding one, each handed over like a scanned page.
+ * Their cached counts are recounted on the way, and those of pages the
+ * strategy changed are dropped. The stats already include these pages as
+ * reused, so they are not counted again.
+ */
+void ProcessManager::InjectCleanPages(InjectionStrategy &strategy,
+                                      ThreadPool &pool,
+                                      const std::vector<ScanRange> &clean) {
+  const auto units = SplitWorkUnits(clean, chunk_size_);
+  pool.Run(units.size(), [&](size_t, size_t unit) {
+    std::vector<uint8_t> page(page_size_);
+    ScanStats reused;
+    for (const auto &range : units[unit]) {
+      for (uint64_t addr = range.start_addr;
+           addr < range.end_addr && !ScanStopped(strategy);) {
+        const uint64_t site =
+            strategy.NextSite(addr, range.end_addr, *range.region);
+        if (site >= range.end_addr) {
+          break;
+        }
+        const uint64_t page_addr = site & ~(page_size_ - 1);
+        if (ReadRange(page_addr, page.data(), page_size_) ==
+            static_cast<ssize_t>(page_size_)) {
+          ScanChunk(*range.region, page_addr, page.data(), page_size_,
+                    strategy, reused);
+        }
+        addr = page_addr + page_size_;
+      }
+    }
+  });
+}
+
+/**
+ * @brief Zeroed word counts for every readable region
+ *
+ * Blocks are aligned to kCountBlockSize, so the first and last block of a
+ * region may be partial. A 64-word classifier block never straddles two.
+ */
+std::vector<RegionStats> ProcessManager::NewRegionStats() const {
+  std::vector<RegionStats> region_stats;
+  region_stats.reserve(readable_regions_.size());
+  for (const auto &region : readable_regions_) {
+    const uint64_t region_start = region.start_addr & ~(kCountBlockSize - 1);
+    const size_t blocks =
+        (region.end_addr - region_start + kCountBlockSize - 1) /
+        kCountBlockSize;
+    region_stats.push_back({&region, 0, 0, region_start,
+                            std::vector<uint32_t>(blocks),
+                            std::vector<uint32_t>(blocks)});
+  }
+  return region_stats;
+}
+
+/**
+ * @brief Word counts of every block from the incremental page cache
+ *
+ * Every cached page was read in full, either by this scan or by an earlier
+ * one that it has not been written since. Pages without an entry are left
+ * out, as InjectSites does when it rereads a block.
+ */
+void ProcessManager::CountCachedWords(
+    std::vector<RegionStats> &region_stats) const {
+  const auto page_words = static_cast<uint32_t>(page_size_ / sizeof(uint64_t));
+  for (size_t i = 0; i < region_stats.size(); i++) {
+    RegionStats &counts = region_stats[i];
+    const MemoryRegion &region = *counts.region;
+    const uint16_t *cache = region_cache_[i];
+    for (uint64_t page = region.start_addr; page < region.end_addr;
+         page += page_size_, cache++) {
+      if (*cache == kUncached) {
+        continue;
+      }
+      const size_t block = (page - counts.region_start) / kCountBlockSize;
+      counts.block_pointers[block] += *cache;
+      counts.block_words[block] += page_words;
+    }
+  }
+}
+
+/**
+ * @brief Second pass of exact-count injection
+ *
+ * @details Picks the requested number of pointers and non-pointers among the
+ * words of writable regions counted by the first pass, maps each pick to a
+ * block through the running sums of the block counts, and rereads only those
+ * blocks. The counted words have not changed since they were counted, so
+ * classifying a block again yields the same words in the same order, and the
+ * n-th word of a class in the block is the one that was picked.
+ */
+void ProcessManager::InjectSites(InjectionStrategy &strategy, ThreadPool &pool,
+                                 const SiteRequest &request,
+                                 const std::vector<ScanRange> &ranges,
+                                 std::vector<RegionStats> &region_stats) {
+  uint64_t total_pointers = 0;
+  uint64_t total_nonpointers = 0;
+  for (auto &counts : region_stats) {
+    for (size_t block = 0; block < counts.block_words.size(); block++) {
+      counts.pointer_count += counts.block_pointers[block];
+      counts.nonpointer_count +=
+          counts.block_words[block] - counts.block_pointers[block];
+    }
+    if (counts.region->is_writable) {
+      total_pointers += counts.pointer_count;
+      total_nonpointers += counts.nonpointer_count;
+    }
+  }
+  if (request.pointers > total_pointers ||
+      request.non_pointers > total_nonpointers) {
+    spdlog::warn("Only {} pointers and {} non-pointers in writable regions; "
+                 "injecting fewer errors than requested",
+                 total_pointers, total_nonpointers);
+  }
+  const auto pointer_picks = PickOrdinals(total_pointers, request.pointers,
+                                          CounterRng::Key(request.key, 0));
+  const auto nonpointer_picks = PickOrdinals(
+      total_nonpointers, request.non_pointers, CounterRng::Key(request.key, 1));
+
+  // Picked words per block, as positions among the block's words of a class
+  struct SiteBlock {
+    const RegionStats *counts;
+    size_t block;
+    std::vector<uint32_t> pointers;
+    std::vector<uint32_t> nonpointers;
+  };
+  std::vector<SiteBlock> site_blocks;
+  uint64_t pointer_base = 0;
+  uint64_t nonpointer_base = 0;
+  size_t pointer_pick = 0;
+  size_t nonpointer_pick = 0;
+  for (const auto &counts : region_stats) {
+    if (!counts.region->is_writable) {
+      continue;
+    }
+    for (size_t block = 0; block < counts.block_words.size() &&
+                           (pointer_pick < pointer_picks.size() ||
+                            nonpointer_pick < nonpointer_picks.size());
+         block++) {
+      const uint64_t pointers = counts.block_pointers[block];
+      const uint64_t nonpointers = counts.block_words[block] - pointers;
+      SiteBlock site_block{&counts, block, {}, {}};
+      for (; pointer_pick < pointer_picks.size() &&
+             pointer_picks[pointer_pick] < pointer_base + pointers;
+           pointer_pick++) {
+        site_block.pointers.push_back(
+            static_cast<uint32_t>(pointer_picks[pointer_pick] - pointer_base));
+      }
+      for (; nonpointer_pick < nonpointer_picks.size() &&
+             nonpointer_picks[nonpointer_pick] < nonpointer_base + nonpointers;
+           nonpointer_pick++) {
+        site_block.nonpointers.push_back(static_cast<uint32_t>(
+            nonpointer_picks[nonpointer_pick] - nonpointer_base));
+      }
+      pointer_base += pointers;
+      nonpointer_base += nonpointers;
+      if (!site_block.pointers.empty() || !site_block.nonpointers.empty()) {
+        site_blocks.push_back(std::move(site_block));
+      }
+    }
+  }
+  spdlog::debug("Picked {} pointers and {} non-pointers in {} blocks",
+                pointer_picks.size(), nonpointer_picks.size(),
+                site_blocks.size());
+
+  pool.Run(site_blocks.size(), [&](size_t, size_t index) {
+    const SiteBlock &site_block = site_blocks[index];
+    const MemoryRegion &region = *site_block.counts->region;
+    const uint64_t block_addr =
+        site_block.counts->region_start + site_block.block * kCountBlockSize;
+    const uint64_t block_start = std::max(block_addr, region.start_addr);
+    const uint64_t block_end =
+        std::min(block_addr + kCountBlockSize, region.end_addr);
+
+    // Hands over the picked words of one class among `mask`, the words of
+    // that class in the classifier block at `addr`
+    auto visit = [&](uint64_t addr, uint64_t *words, uint64_t mask,
+                     const std::vector<uint32_t> &picks, size_t &next,
+                     uint64_t &seen, bool is_pointer) {
+      const auto in_block = static_cast<uint64_t>(std::popcount(mask));
+      for (; next < picks.size() && picks[next] < seen + in_block; next++) {
+        uint64_t rest = mask;
+        for (uint64_t skip = picks[next] - seen; skip > 0; skip--) {
+          rest &= rest - 1;
+        }
+        const auto word = static_cast<unsigned>(std::countr_zero(rest));
+        const uint64_t word_addr = addr + word * sizeof(uint64_t);
+        const bool changed =
+            is_pointer ? strategy.HandlePointer(word_addr, words[word],
+                                                region.is_writable, region)
+                       : strategy.HandleNonPointer(word_addr, words[word],
+                                                   region.is_writable, region);
+        if (!changed) {
+          continue;
+        }
+        WriteMemory(word_addr, &words[word], sizeof(uint64_t));
+        if (uint16_t *count = PageCacheFor(region, word_addr)) {
+          *count = kUncached;
+        }
+      }
+      seen += in_block;
+    };
+
+    // Only the parts of the block that the first pass read were counted,
+    // or with the page cache the pages it holds counts for
+    std::vector<std::pair<uint64_t, uint64_t>> spans;
+    if (incremental_) {
+      const uint16_t *cache = PageCacheFor(region, block_start);
+      for (uint64_t page = block_start; page < block_end;
+           page += page_size_, cache++) {
+        if (*cache == kUncached) {
+          continue;
+        }
+        if (!spans.empty() && spans.back().second == page) {
+          spans.back().second += page_size_;
+        } else {
+          spans.emplace_back(page, page + page_size_);
+        }
+      }
+    } else {
+      auto it = std::upper_bound(ranges.begin(), ranges.end(), block_start,
+                                 [](uint64_t addr, const ScanRange &range) {
+                                   return addr < range.end_addr;
+                                 });
+      for (; it != ranges.end() && it->start_addr < block_end; ++it) {
+        spans.emplace_back(std::max(it->start_addr, block_start),
+                           std::min(it->end_addr, block_end));
+      }
+    }
+
+    size_t next_pointer = 0;
+    size_t next_nonpointer = 0;
+    uint64_t seen_pointers = 0;
+    uint64_t seen_nonpointers = 0;
+    std::vector<uint64_t> words;
+    for (const auto &[start, end] : spans) {
+      words.resize((end - start) / sizeof(uint64_t));
+      auto *data = reinterpret_cast<uint8_t *>(words.data());
+      if (ReadRange(start, data, end - start) !=
+          static_cast<ssize_t>(end - start)) {
+        spdlog::warn("Failed to reread block at {:#x}: {}", block_addr,
+                     strerror(errno));
+        return;
+      }
+      for (size_t first = 0; first < words.size();
+           first += kClassifyBlockWords) {
+        const size_t count = std::min(kClassifyBlockWords, words.size() - first);
+        const uint64_t valid =
+            count == kClassifyBlockWords ? ~0ULL : (1ULL << count) - 1;
+        const uint64_t pointers =
+            PointerMask(data + first * sizeof(uint64_t), count);
+        const uint64_t addr = start + first * sizeof(uint64_t);
+        visit(addr, words.data() + first, pointers, site_block.pointers,
+              next_pointer, seen_pointers, true);
+        visit(addr, words.data() + first, ~pointers & valid,
+              site_block.nonpointers, next_nonpointer, seen_nonpointers,
+              false);
+      }
+    }
+  });
+}
+
+/**
+ * @brief Sizes the scan buffers, binding them to buffer_node_ if one is set
+ *
+ * Buffers keep their memory between scans, so the binding only has to move
+ * pages of buffers that were reallocated.
+ */
+void ProcessManager::PrepareScanBuffers(size_t count, size_t size) {
+  scan_buffers_.resize(count);
+  for (auto &buffer : scan_buffers_) {
+    buffer.resize(size);
+    if (buffer_node_ >= 0 &&
+        !BindToNode(buffer.data(), buffer.size(), buffer_node_)) {
+      spdlog::warn("Failed to bind scan buffers to NUMA node {}: {}",
+                   buffer_node_, strerror(errno));
+      buffer_node_ = -1;
+    }
+  }
+}
+
+/**
+ * @brief Cuts the work list into units of at most `unit_size` bytes
+ *
+ * Large ranges are split and small ones are packed together, so every unit
+ * is roughly one scan buffer's worth of reads and units can be balanced
+ * across threads.
+ */
+std::vector<std::vector<ProcessManager::ScanRange>>
+ProcessManager::SplitWorkUnits(const std::vector<ScanRange> &ranges,
+                               size_t unit_size) const {
+  std::vector<std::vector<ScanRange>> units;
+  size_t unit_bytes = unit_size;
+  for (const auto &range : ranges) {
+    for (uint64_t addr = range.start_addr; addr < range.end_addr;) {
+      if (unit_bytes == unit_size) {
+        units.emplace_back();
+        unit_bytes = 0;
+      }
+      const uint64_t end =
+          std::min<uint64_t>(range.end_addr, addr + (unit_size - unit_bytes));
+      units.back().push_back({range.region, addr, end});
+      unit_bytes += end - addr;
+      addr = end;
+    }
+  }
+  return units;
+}
+
+bool ProcessManager::UseProcMem() const {
+  return use_proc_mem_.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Switches bulk reads to /proc/<pid>/mem after process_vm_readv failed
+ *
+ * Only happens in Auto mode, and only for errors other than EFAULT: a fault
+ * concerns a single range, anything else means the syscall is unusable.
+ *
+ * @return true if reads should be retried through /proc/<pid>/mem
+ */
+bool ProcessManager::SwitchToProcMem(int error) const {
+  if (error == EFAULT || backend_ != MemoryBackend::Auto || mem_fd_ == -1) {
+    return false;
+  }
+  if (!use_proc_mem_.exchange(true)) {
+    spdlog::info("process_vm_readv failed ({}), switching to /proc/{}/mem",
+                 strerror(error), target_pid_);
+  }
+  return true;
+}
+
+/**
+ * @brief Reads address-contiguous remote ranges with one syscall
+ *
+ * With /proc/<pid>/mem the remote iovecs must be contiguous, since preadv
+ * takes a single file offset.
+ *
+ * @return Number of bytes read before the first fault, or -1
+ */
+ssize_t ProcessManager::ReadVectored(const struct iovec *local_iov,
+                                     const struct iovec *remote_iov,
+                                     size_t count, bool proc_mem) const {
+  if (proc_mem) {
+    return preadv(mem_fd_, local_iov, static_cast<int>(count),
+                  static_cast<off_t>(
+                      reinterpret_cast<uint64_t>(remote_iov[0].iov_base)));
+  }
+  return process_vm_readv(target_pid_, local_iov, count, remote_iov, count, 0);
+}
+
+/**
+ * @brief Performs a single read of [addr, addr + size)
+ *
+ * @return Number of bytes read before the first fault, or -1 if the first
+ *         page could not be read
+ */
+ssize_t ProcessManager::ReadRange(uint64_t addr, uint8_t *data,
+                                  size_t size) const {
+  struct iovec local_iov = {.iov_base = data, .iov_len = size};
+  struct iovec remote_iov = {.iov_base = reinterpret_cast<void *>(addr),
+                             .iov_len = size};
+
+  bool proc_mem = UseProcMem();
+  ssize_t read_bytes = ReadVectored(&local_iov, &remote_iov, 1, proc_mem);
+  if (read_bytes == -1 && !proc_mem && SwitchToProcMem(errno)) {
+    read_bytes = ReadVectored(&local_iov, &remote_iov, 1, true);
+  } else if (read_bytes == -1 && !proc_mem && errno != EFAULT) {
+    // No bulk interface is usable; ReadMemory falls back to ptrace
+    return ReadMemory(addr, data, size) ? static_cast<ssize_t>(size) : -1;
+  }
+  return read_bytes;
+}
+
+/**
+ * @brief Reads an extent, splitting it recursively around faults
+ *
+ * A short read keeps everything before the fault and retries from there. A
+ * read that fails on its first page is split in half until the unreadable
+ * pages are isolated, so a guard page or a racing munmap only costs the pages
+ * it actually covers.
+ *
+ * @param extent The extent to read
+ * @param readable Receives the sub-extents that were read successfully
+ *
+ * @return Number of bytes that could not be read
+ */
+size_t ProcessManager::ReadBisect(const ReadExtent &extent,
+                                  std::vector<ReadExtent> &readable) const {
+  ReadExtent rest = extent;
+  size_t skipped = 0;
+
+  while (rest.size > 0) {
+    ssize_t read_bytes = ReadRange(rest.addr, rest.data, rest.size);
+    size_t good = read_bytes > 0 ? static_cast<size_t>(read_bytes) : 0;
+    if (good == rest.size) {
+      readable.push_back(rest);
+      break;
+    }
+
+    good -= good % page_size_;
+    if (good > 0) {
+      readable.push_back({rest.region, rest.addr, rest.data, good});
+    } else if (rest.size <= page_size_) {
+      skipped += rest.size;
+      break;
+    } else {
+      size_t half = (rest.size / 2) - (rest.size / 2) % page_size_;
+      good = std::max(half, page_size_);
+      skipped += ReadBisect({rest.region, rest.addr, rest.data, good}, readable);
+    }
+    rest.addr += good;
+    rest.data += good;
+    rest.size -= good;
+  }
+  return skipped;
+}
+
+/**
+ * @brief Reads a chunk made of extents from one or more regions
+ *
+ * All extents are submitted in a single process_vm_readv call where possible;
+ * with /proc/<pid>/mem, each run of address-contiguous extents is one preadv.
+ * On a short transfer, the extents before the fault are kept, the faulting
+ * extent is bisected and the remaining extents are submitted again.
+ *
+ * @return Number of bytes that could not be read
+ */
+size_t ProcessManager::ReadChunk(const std::vector<ReadExtent> &extents,
+                                 std::vector<ReadExtent> &readable) const {
+  std::vector<struct iovec> local_iov;
+  std::vector<struct iovec> remote_iov;
+  local_iov.reserve(extents.size());
+  remote_iov.reserve(extents.size());
+  for (const auto &extent : extents) {
+    local_iov.push_back({.iov_base = extent.data, .iov_len = extent.size});
+    remote_iov.push_back({.iov_base = reinterpret_cast<void *>(extent.addr),
+                          .iov_len = extent.size});
+  }
+
+  size_t skipped = 0;
+  size_t index = 0;
+  while (index < extents.size()) {
+    bool proc_mem = UseProcMem();
+    size_t batch = 1;
+    size_t limit = std::min(extents.size() - index,
+                            static_cast<size_t>(IOV_MAX));
+    if (!proc_mem) {
+      batch = limit;
+    } else {
+      while (batch < limit && extents[index + batch].addr ==
+                                  extents[index + batch - 1].addr +
+                                      extents[index + batch - 1].size) {
+        batch++;
+      }
+    }
+
+    ssize_t read_bytes =
+        ReadVectored(&local_iov[index], &remote_iov[index], batch, proc_mem);
+    if (read_bytes == -1 && !proc_mem && SwitchToProcMem(errno)) {
+      continue;
+    }
+    size_t remaining = read_bytes > 0 ? static_cast<size_t>(read_bytes) : 0;
+
+    for (; batch > 0 && remaining >= extents[index].size; batch--) {
+      remaining -= extents[index].size;
+      readable.push_back(extents[index++]);
+    }
+    if (batch > 0) {
+      skipped += ReadBisect(extents[index++], readable);
+    }
+  }
+  return skipped;
+}
+
+ProcessManager::RangeCursor::RangeCursor(const std::vector<ScanRange> &ranges)
+    : it(ranges.begin()), end(ranges.end()),
+      addr(ranges.empty() ? 0 : ranges.front().start_addr) {}
+
+/**
+ * @brief Builds the list of ranges a scan reads
+ *
+ * Normally every readable region is read in full. With skip_nonresident_, a
+ * pagemap pre-pass (PAGEMAP_SCAN where the kernel has it) keeps only resident
+ * pages, so untouched reservations are not faulted in, swapped pages are not
+ * swapped in and cold file mappings cause no disk I/O. The bytes left out are
+ * counted in bytes_not_resident.
+ *
+ * In incremental mode, pages that are not soft-dirty (written since the last
+ * scan) and have a cached pointer count are left out as well; their cached
+ * counts are added to the stats instead. If `clean` is given, it receives
+ * the ranges of those pages.
+ *
+ * Regions the strategy's filter rejects are not read at all and are counted
+ * in bytes_filtered.
+ */
+bool ProcessManager::BuildWorkList(const RegionFilter &filter,
+                                   std::vector<ScanRange> &ranges,
+                                   ScanStats &stats,
+                                   std::vector<ScanRange> *clean) {
+  if (incremental_ && !Pagemap::SoftDirtySupported()) {
+    spdlog::warn("Kernel does not track soft-dirty pages; incremental "
+                 "scanning disabled");
+    incremental_ = false;
+  }
+
+  Pagemap pagemap(target_pid_);
+  if ((skip_nonresident_ || incremental_) && !pagemap.Open()) {
+    spdlog::warn("Failed to open pagemap of {}: {}; scanning all pages",
+                 target_pid_, strerror(errno));
+  }
+
+  if (incremental_) {
+    SyncPageCache();
+  }
+
+  std::vector<PageRun> runs;
+  for (size_t i = 0; i < readable_regions_.size(); i++) {
+    const MemoryRegion &region = readable_regions_[i];
+    runs.clear();
+
+    if (!filter.Matches(region)) {
+      stats.bytes_filtered += region.end_addr - region.start_addr;
+      if (incremental_) {
+        // The soft-dirty bits are cleared for all pages after this scan, so
+        // a later scan that wants the region has to read all of it
+        std::fill_n(region_cache_[i],
+                    (region.end_addr - region.start_addr) / page_size_,
+                    kUncached);
+      }
+      continue;
+    }
+    stats.regions_scanned++;
+
+    uint16_t *cache = incremental_ ? region_cache_[i] : nullptr;
+    uint64_t reused = 0;
+    uint64_t reused_pointers = 0;
+    auto resident = [&](uint64_t categories) {
+      return !skip_nonresident_ || Pagemap::IsResident(categories);
+    };
+    // Only the page cache needs a look at every page
+    auto uncached = [&](uint64_t addr, uint64_t categories) {
+      if (!resident(categories)) {
+        return false;
+      }
+      uint16_t count = cache[(addr - region.start_addr) / page_size_];
+      if ((categories & Pagemap::kIsSoftDirty) || count == kUncached) {
+        return true;
+      }
+      reused += page_size_;
+      reused_pointers += count;
+      if (clean != nullptr) {
+        if (!clean->empty() && clean->back().region == &region &&
+            clean->back().end_addr == addr) {
+          clean->back().end_addr += page_size_;
+        } else {
+          clean->push_back({&region, addr, addr + page_size_});
+        }
+      }
+      return false;
+    };
+
+    // A walk that fails partway has already reported some pages as clean
+    const size_t clean_size = clean != nullptr ? clean->size() : 0;
+    bool collected = false;
+    if (pagemap.IsOpen()) {
+      collected = cache != nullptr
+                      ? pagemap.CollectRuns(region.start_addr,
+                                            region.end_addr, uncached, runs)
+                      : pagemap.CollectRuns(region.start_addr,
+                                            region.end_addr, resident, runs);
+    }
+    if (!collected) {
+      // The whole region is read, so none of it is reused. Its reused bytes
+      // are only added to the stats below.
+      if (clean != nullptr) {
+        clean->resize(clean_size);
+      }
+      ranges.push_back({&region, region.start_addr, region.end_addr});
+      continue;
+    }
+
+    uint64_t kept = 0;
+    for (const auto &run : runs) {
+      ranges.push_back({&region, run.start_addr, run.end_addr});
+      kept += run.end_addr - run.start_addr;
+    }
+    stats.bytes_not_resident +=
+        (region.end_addr - region.start_addr) - kept - reused;
+
+    stats.bytes_reused += reused;
+    stats.bytes_readable += reused;
+    if (region.is_writable) {
+      stats.bytes_writable += reused;
+    }
+    if (region.is_executable) {
+      stats.bytes_executable += reused;
+    }
+    stats.pointers_found += reused_pointers;
+  }
+  return true;
+}
+
+/**
+ * @brief Lines the page cache up with the current readable regions
+ *
+ * Regions whose bounds are unchanged keep their cached counts. A region that
+ * grew, shrank, was split or was merged with its neighbours takes over the
+ * counts of the pages that stayed mapped, such as the old part of a grown
+ * [heap] or [stack]; its other pages start out uncached. Entries for vanished
+ * regions are dropped. Pages written meanwhile are soft-dirty, so their
+ * carried-over counts are not used.
+ */
+void ProcessManager::SyncPageCache() {
+  decltype(page_cache_) next;
+  region_cache_.assign(readable_regions_.size(), nullptr);
+
+  for (size_t i = 0; i < readable_regions_.size(); i++) {
+    const MemoryRegion &region = readable_regions_[i];
+    auto key = std::make_pair(region.start_addr, region.end_addr);
+
+    // Regions do not overlap, so no other one needs an entry with these bounds
+    auto node = page_cache_.extract(key);
+    if (!node.empty()) {
+      region_cache_[i] =
+          next.emplace(key, std::move(node.mapped())).first->second.data();
+      continue;
+    }
+
+    std::vector<uint16_t> counts(
+        (region.end_addr - region.start_addr) / page_size_, kUncached);
+    auto old = page_cache_.lower_bound({region.start_addr, 0});
+    if (old != page_cache_.begin()) {
+      --old; // May start below the region and reach into it
+    }
+    for (; old != page_cache_.end() && old->first.first < region.end_addr;
+         ++old) {
+      const auto [old_start, old_end] = old->first;
+      const uint64_t from = std::max(region.start_addr, old_start);
+      const uint64_t to = std::min(region.end_addr, old_end);
+      if (from >= to) {
+        continue;
+      }
+      std::copy_n(
+          old->second.begin() +
+              static_cast<std::ptrdiff_t>((from - old_start) / page_size_),
+          (to - from) / page_size_,
+          counts.begin() + static_cast<std::ptrdiff_t>(
+                               (from - region.start_addr) / page_size_));
+    }
+    region_cache_[i] = next.emplace(key, std::move(counts)).first->second.data();
+  }
+  page_cache_.swap(next);
+}
+
+/**
+ * @brief Returns the cache entry of the page containing addr, or nullptr
+ *
+ * Entries of distinct pages are written by whichever thread scans the page,
+ * so no locking is needed.
+ */
+uint16_t *ProcessManager::PageCacheFor(const MemoryRegion &region,
+                                       uint64_t addr) const {
+  if (!incremental_ || region_cache_.size() != readable_regions_.size()) {
+    return nullptr;
+  }
+  size_t index = static_cast<size_t>(&region - readable_regions_.data());
+  return region_cache_[index] + (addr - region.start_addr) / page_size_;
+}
+
+/**
+ * @brief Clears the soft-dirty bits of the target so the next incremental
+ * scan only sees pages written from now on
+ */
+bool ProcessManager::ClearSoftDirty() const {
+  std::string path = "/proc/" + std::to_string(target_pid_) + "/clear_refs";
+  std::ofstream clear_refs(path);
+  if (!(clear_refs << "4" << std::flush)) {
+    spdlog::error("Failed to clear soft-dirty bits via {}", path);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Fills a chunk with extents from as many consecutive ranges as fit
+ *
+ * @param cursor Advanced past the bytes added to the chunk
+ * @param buffer Local memory the extents are read into
+ * @param size Capacity of the buffer
+ * @param max_extents Upper bound on the number of extents (iovecs)
+ * @param extents Receives the extents; cleared first
+ */
+void ProcessManager::FillChunk(RangeCursor &cursor, uint8_t *buffer,
+                               size_t size, size_t max_extents,
+                               std::vector<ReadExtent> &extents) const {
+  extents.clear();
+  size_t filled = 0;
+  while (filled < size && !cursor.Done() && extents.size() < max_extents) {
+    const ScanRange &range = *cursor.it;
+    size_t to_read = std::min(range.end_addr - cursor.addr, size - filled);
+
+    extents.push_back({range.region, cursor.addr, buffer + filled, to_read});
+    filled += to_read;
+
+    cursor.addr += to_read;
+    if (cursor.addr >= range.end_addr && ++cursor.it != cursor.end) {
+      cursor.addr = cursor.it->start_addr;
+    }
+  }
+}
+
+void ProcessManager::ScanRegions(const std::vector<ScanRange> &ranges,
+                                 ScanBuffer &buffer,
+                                 InjectionStrategy &strategy,
+                                 ScanStats &local_stats) {
+  RangeCursor cursor(ranges);
+  ScanRegions(cursor, buffer, strategy, local_stats);
+}
+
+// Scans from `cursor` to the end of its ranges
+void ProcessManager::ScanRegions(RangeCursor &cursor,
+                                 ScanBuffer &buffer,
+                                 InjectionStrategy &strategy,
+                                 ScanStats &local_stats) {
+  std::vector<ReadExtent> extents;
+  std::vector<ReadExtent> readable;
+
+  while (!cursor.Done() && !ScanStopped(strategy)) {
+    FillChunk(cursor, buffer.data(), buffer.size(),
+              static_cast<size_t>(IOV_MAX), extents);
+
+    readable.clear();
+    local_stats.bytes_skipped += ReadChunk(extents, readable);
+
+    for (const auto &extent : readable) {
+      ScanChunk(*extent.region, extent.addr, extent.data, extent.size,
+                strategy, local_stats);
+    }
+  }
+}
+
+/**
+ * @brief Scans with separate reader, classifier and write-back stages
+ *
+ * Reader i fills buffers from its own part of the buffer pool and hands them
+ * to classifier i over an SPSC ring; emptied buffers travel back over a
+ * second ring. Classifiers queue modified words to a single write-back
+ * stage. Reading, classifying and writing therefore overlap instead of
+ * stalling each other within one thread.
+ *
+ * Every stage is one task of a pool run, so the stages wait for each other
+ * and all of them must run at once: the pool needs a worker per stage. A
+ * worker only steals a task after finishing its own, so no stage ever waits
+ * behind one that waits for it.
+ *
+ * @param reader_ranges Ranges for each reader/classifier pair
+ */
+void ProcessManager::ScanPipeline(
+    ThreadPool &pool, const std::vector<std::vector<ScanRange>> &reader_ranges,
+    InjectionStrategy &strategy, ScanStats &stats) {
+  using Clock = std::chrono::steady_clock;
+  constexpr uint32_t kEndOfStream = std::numeric_limits<uint32_t>::max();
+  constexpr size_t kWriteRingSize = 4096;
+
+  const size_t lanes = reader_ranges.size();
+  const size_t depth = queue_depth_;
+
+  // Buffer i of the pool belongs to lane i / depth
+  struct Slot {
+    std::vector<ReadExtent> extents;
+    std::vector<ReadExtent> readable;
+    size_t skipped{0};
+  };
+  std::vector<Slot> slots(lanes * depth);
+  PrepareScanBuffers(lanes * depth, chunk_size_);
+
+  std::vector<std::unique_ptr<SpscRing<uint32_t>>> full_rings;
+  std::vector<std::unique_ptr<SpscRing<uint32_t>>> free_rings;
+  std::vector<std::unique_ptr<SpscRing<WriteBack>>> write_rings;
+  for (size_t lane = 0; lane < lanes; lane++) {
+    full_rings.push_back(std::make_unique<SpscRing<uint32_t>>(depth + 1));
+    free_rings.push_back(std::make_unique<SpscRing<uint32_t>>(depth + 1));
+    write_rings.push_back(
+        std::make_unique<SpscRing<WriteBack>>(kWriteRingSize));
+    for (size_t i = 0; i < depth; i++) {
+      free_rings[lane]->TryPush(static_cast<uint32_t>(lane * depth + i));
+    }
+  }
+
+  std::vector<ScanStats> reader_stats(lanes);
+  std::vector<ScanStats> classifier_stats(lanes);
+  std::vector<Clock::duration> reader_busy(lanes, Clock::duration::zero());
+  std::vector<Clock::duration> classifier_busy(lanes,
+                                               Clock::duration::zero());
+  Clock::duration writer_busy = Clock::duration::zero();
+  std::atomic<size_t> classifiers_done{0};
+
+  // Reader: target memory -> buffer pool
+  auto read_lane = [&](size_t lane) {
+    RangeCursor cursor(reader_ranges[lane]);
+    while (!cursor.Done() && !ScanStopped(strategy)) {
+      uint32_t index;
+      while (!free_rings[lane]->TryPop(index)) {
+        std::this_thread::yield();
+      }
+
+      auto busy_start = Clock::now();
+      Slot &slot = slots[index];
+      FillChunk(cursor, scan_buffers_[index].data(), chunk_size_,
+                static_cast<size_t>(IOV_MAX), slot.extents);
+      slot.readable.clear();
+      slot.skipped = ReadChunk(slot.extents, slot.readable);
+      reader_busy[lane] += Clock::now() - busy_start;
+
+      while (!full_rings[lane]->TryPush(index)) {
+        std::this_thread::yield();
+      }
+    }
+    while (!full_rings[lane]->TryPush(kEndOfStream)) {
+      std::this_thread::yield();
+    }
+  };
+
+  // Classifier: buffer pool -> strategy callbacks -> write-back queue
+  auto classify_lane = [&](size_t lane) {
+    std::vector<WriteBack> writes;
+    for (;;) {
+      uint32_t index;
+      while (!full_rings[lane]->TryPop(index)) {
+        std::this_thread::yield();
+      }
+      if (index == kEndOfStream) {
+        break;
+      }
+
+      auto busy_start = Clock::now();
+      Slot &slot = slots[index];
+      classifier_stats[lane].bytes_skipped += slot.skipped;
+      writes.clear();
+      for (const auto &extent : slot.readable) {
+        ScanChunk(*extent.region, extent.addr, extent.data, extent.size,
+                  strategy, classifier_stats[lane], &writes);
+      }
+      classifier_busy[lane] += Clock::now() - busy_start;
+
+      // The free ring has room for every buffer of the lane
+      free_rings[lane]->TryPush(index);
+      for (const auto &write : writes) {
+        while (!write_rings[lane]->TryPush(write)) {
+          std::this_thread::yield();
+        }
+      }
+    }
+    classifiers_done.fetch_add(1, std::memory_order_release);
+  };
+
+  // Write-back: drains every classifier's queue until all of them are done
+  auto write_back = [&]() {
+    for (;;) {
+      bool done = classifiers_done.load(std::memory_order_acquire) == lanes;
+      bool idle = true;
+      for (auto &ring : write_rings) {
+        WriteBack write;
+        while (ring->TryPop(write)) {
+          auto busy_start = Clock::now();
+          WriteMemory(write.addr, &write.value, sizeof(write.value));
+          writer_busy += Clock::now() - busy_start;
+          idle = false;
+        }
+      }
+      if (idle) {
+        if (done) {
+          break;
+        }
+        std::this_thread::yield();
+      }
+    }
+  };
+
+  // Tasks 2i and 2i + 1 are reader and classifier of lane i, the last one
+  // is the write-back stage
+  auto start_time = Clock::now();
+  pool.Run(2 * lanes + 1, [&](size_t, size_t task) {
+    if (task == 2 * lanes) {
+      write_back();
+    } else if (task % 2 == 0) {
+      read_lane(task / 2);
+    } else {
+      classify_lane(task / 2);
+    }
+  });
+  auto wall_time = Clock::now() - start_time;
+
+  Clock::duration reader_total = Clock::duration::zero();
+  Clock::duration classifier_total = Clock::duration::zero();
+  for (size_t lane = 0; lane < lanes; lane++) {
+    stats.Merge(reader_stats[lane]);
+    stats.Merge(classifier_stats[lane]);
+    reader_total += reader_busy[lane];
+    classifier_total += classifier_busy[lane];
+  }
+
+  auto occupancy = [&](Clock::duration busy, size_t threads_in_stage) {
+    double wall = static_cast<double>(wall_time.count()) *
+                  static_cast<double>(threads_in_stage);
+    return wall > 0 ? static_cast<double>(busy.count()) / wall : 0.0;
+  };
+  stats.reader_occupancy = occupancy(reader_total, lanes);
+  stats.classifier_occupancy = occupancy(classifier_total, lanes);
+  stats.writer_occupancy = occupancy(writer_busy, 1);
+}
+
+/**
+ * @brief Frees the rings given up mid-scan whose reads have all completed
+ *
+ * A ring that is closed with reads in flight lets them finish in the
+ * background, so its buffer could only be freed once they did. Until then
+ * ring and buffer are kept, and their completions are collected here
+ * without waiting. Called between scans only.
+ */
+void ProcessManager::ReapStuckRings() {
+  std::lock_guard<std::mutex> lock(stuck_rings_mutex_);
+  std::erase_if(stuck_rings_, [](StuckRing &stuck) {
+    uint64_t slot;
+    int result;
+    while (stuck.pending > 0 && stuck.ring->PopCompletion(slot, result)) {
+      stuck.pending--;
+    }
+    return stuck.pending == 0;
+  });
+}
+
+/**
+ * @brief Handles the result of a single asynchronous extent read
+ *
+ * Mirrors ReadBisect: a complete read is kept as is, otherwise the bytes
+ * before the fault are kept and the rest is bisected synchronously.
+ *
+ * @return Number of bytes that could not be read
+ */
+size_t ProcessManager::CompleteRead(const ReadExtent &extent, int result,
+                                    std::vector<ReadExtent> &readable) const {
+  size_t good = result > 0 ? static_cast<size_t>(result) : 0;
+  if (good == extent.size) {
+    readable.push_back(extent);
+    return 0;
+  }
+
+  good -= good % page_size_;
+  if (good > 0) {
+    readable.push_back({extent.region, extent.addr, extent.data, good});
+  }
+  return ReadBisect({extent.region, extent.addr + good, extent.data + good,
+                     extent.size - good},
+                    readable);
+}
+
+/**
+ * @brief Scans regions with up to queue_depth_ reads in flight
+ *
+ * Each chunk-sized slot of `buffer` holds one outstanding read of
+ * /proc/<pid>/mem. New reads are submitted before a completed buffer is
+ * classified, so classification overlaps with the reads still in flight.
+ *
+ * If the ring fails later on, the reads in flight are collected first, as
+ * they own their slots and the caller reuses `buffer` and `ring` for its
+ * next unit. The reads the kernel never took and the rest of the unit are
+ * then read synchronously. Should even collecting fail, `ring` and `buffer`
+ * are given up, as the kernel may still write to the buffer, and the reads
+ * not collected are redone synchronously in a new buffer.
+ *
+ * @return false if the ring failed before any read was submitted, in which
+ *         case the caller should fall back to ScanRegions
+ */
+bool ProcessManager::ScanRegionsAsync(const std::vector<ScanRange> &ranges,
+                                      ScanBuffer &buffer,
+                                      std::unique_ptr<IoUring> &ring_owner,
+                                      InjectionStrategy &strategy,
+                                      ScanStats &local_stats) {
+  IoUring &ring = *ring_owner;
+  const size_t slots = buffer.size() / chunk_size_;
+  std::vector<ReadExtent> in_flight(slots);
+  std::vector<uint64_t> free_slots;
+  std::vector<ReadExtent> readable;
+  for (size_t slot = slots; slot > 0; slot--) {
+    free_slots.push_back(slot - 1);
+  }
+
+  RangeCursor cursor(ranges);
+  std::vector<ReadExtent> extents;
+  std::vector<uint64_t> queued; // Slots prepared since the last submission
+  size_t pending = 0;
+  bool submitted_any = false;
+
+  auto complete = [&](uint64_t slot, int result) {
+    pending--;
+    readable.clear();
+    local_stats.bytes_skipped +=
+        CompleteRead(in_flight[slot], result, readable);
+    for (const auto &extent : readable) {
+      ScanChunk(*extent.region, extent.addr, extent.data, extent.size,
+                strategy, local_stats);
+    }
+    free_slots.push_back(slot);
+  };
+
+  while (!cursor.Done() || pending > 0) {
+    // Keep the queue full, one extent per slot. Once the strategy saturates,
+    // only the reads in flight are collected.
+    if (ScanStopped(strategy)) {
+      cursor.it = cursor.end;
+      if (pending == 0) {
+        break;
+      }
+    }
+    queued.clear();
+    while (!free_slots.empty() && !cursor.Done()) {
+      uint64_t slot = free_slots.back();
+      FillChunk(cursor, buffer.data() + slot * chunk_size_, chunk_size_, 1,
+                extents);
+      const ReadExtent &extent = extents.front();
+
+      // The SQ holds queue_depth_ entries, as many as there are slots
+      ring.PrepareRead(mem_fd_, extent.data,
+                       static_cast<unsigned>(extent.size), extent.addr, slot);
+      free_slots.pop_back();
+      in_flight[slot] = extent;
+      queued.push_back(slot);
+      pending++;
+    }
+
+    if (!ring.SubmitAndWait(1)) {
+      if (!submitted_any) {
+        return false;
+      }
+      break;
+    }
+    submitted_any = true;
+
+    uint64_t slot;
+    int result;
+    if (ring.PopCompletion(slot, result)) {
+      complete(slot, result);
+    }
+  }
+  if (pending == 0) {
+    return true;
+  }
+
+  // Returning false would make the caller rescan, and inject into, the
+  // chunks already done
+  spdlog::error("io_uring_enter failed mid-scan, reading the rest "
+                "synchronously: {}",
+                strerror(errno));
+  const unsigned taken_back = ring.TakeBackUnsubmitted();
+  const size_t unsubmitted = std::min<size_t>(taken_back, queued.size());
+  std::vector<ReadExtent> unread;
+  for (size_t i = queued.size() - unsubmitted; i < queued.size(); i++) {
+    unread.push_back(in_flight[queued[i]]);
+  }
+  pending -= unsubmitted;
+  while (pending > 0) {
+    uint64_t slot;
+    int result;
+    if (ring.PopCompletion(slot, result)) {
+      complete(slot, result);
+    } else if (!ring.WaitCompletions(1)) {
+      spdlog::error("Giving up io_uring reads in flight: {}",
+                    strerror(errno));
+      // Both are set aside until the kernel is done with them, and the
+      // caller sets up a new ring. Every read not collected yet is redone in
+      // a new buffer.
+      const uint8_t *old_buffer = buffer.data();
+      {
+        std::lock_guard<std::mutex> lock(stuck_rings_mutex_);
+        stuck_rings_.push_back(
+            {std::move(buffer), std::move(ring_owner), pending});
+      }
+      buffer.assign(slots * chunk_size_, 0);
+      std::vector<bool> is_free(slots);
+      for (uint64_t free_slot : free_slots) {
+        is_free[free_slot] = true;
+      }
+      unread.clear();
+      for (size_t i = 0; i < slots; i++) {
+        if (!is_free[i]) {
+          ReadExtent extent = in_flight[i];
+          extent.data = buffer.data() + (extent.data - old_buffer);
+          unread.push_back(extent);
+        }
+      }
+      break;
+    }
+  }
+  for (const auto &extent : unread) {
+    readable.clear();
+    local_stats.bytes_skipped += ReadChunk({extent}, readable);
+    for (const auto &chunk : readable) {
+      ScanChunk(*chunk.region, chunk.addr, chunk.data, chunk.size, strategy,
+                local_stats);
+    }
+  }
+  ScanRegions(cursor, buffer, strategy, local_stats);
+  return true;
+}
+
+void ProcessManager::ScanChunk(const MemoryRegion &region, uint64_t addr,
+                               uint8_t *data, size_t size,
+                               InjectionStrategy &strategy,
+                               ScanStats &local_stats,
+                               std::vector<WriteBack> *deferred_writes) {
+  // Extents are page aligned, so the cache entries are consecutive
+  uint16_t *page_counts = PageCacheFor(region, addr);
+  if (page_counts != nullptr) {
+    std::fill_n(page_counts, (size + page_size_ - 1) / page_size_, 0);
+  }
+
+  (this->*chunk_kernel_)(region, addr, data, size, strategy, local_stats,
+                         page_counts, deferred_writes);
+
+  local_stats.total_bytes_scanned += size;
+  local_stats.bytes_readable += size;
+  if (region.is_writable) {
+    local_stats.bytes_writable += size;
+  }
+  if (region.is_executable) {
+    local_stats.bytes_executable += size;
+  }
+}
+
+/**
+ * @brief Word loop of ScanChunk for one strategy type
+ *
+ * @details Words are classified in blocks of kClassifyBlockWords and each
+ * block is passed to the strategy's HandleBatch with a pointer mask. On a
+ * final Strategy that call is resolved at compile time and can be inlined.
+ * A block is skipped without a call if it has no words for the callbacks
+ * the strategy asked for.
+ */
+template <typename Strategy, bool kPointers, bool kNonPointers>
+void ProcessManager::ClassifyChunk(const MemoryRegion &region, uint64_t addr,
+                                   uint8_t *data, size_t size,
+                                   InjectionStrategy &base_strategy,
+                                   ScanStats &local_stats,
+                                   uint16_t *page_counts,
+                                   std::vector<WriteBack> *deferred_writes) {
+  auto &strategy = static_cast<Strategy &>(base_strategy);
+  uint64_t block_words[kClassifyBlockWords];
+
+  const size_t words = size / sizeof(uint64_t);
+  for (size_t block = 0; block < words; block += kClassifyBlockWords) {
+    const size_t count = std::min(kClassifyBlockWords, words - block);
+    const size_t block_offset = block * sizeof(uint64_t);
+    const uint8_t *block_data = data + block_offset;
+
+    const uint64_t pointers = PointerMask(block_data, count);
+
+    // A block never crosses a page boundary
+    const auto found = static_cast<uint16_t>(std::popcount(pointers));
+    local_stats.pointers_found += found;
+    if (page_counts != nullptr &&
+        page_counts[block_offset / page_size_] != kUncached) {
+      page_counts[block_offset / page_size_] += found;
+    }
+
+    const uint64_t valid =
+        count == kClassifyBlockWords ? ~0ULL : (1ULL << count) - 1;
+    uint64_t wanted = 0;
+    if constexpr (kPointers) {
+      wanted |= pointers;
+    }
+    if constexpr (kNonPointers) {
+      wanted |= ~pointers & valid;
+    }
+    if (wanted == 0) {
+      continue;
+    }
+
+    std::memcpy(block_words, block_data, count * sizeof(uint64_t));
+    uint64_t modified =
+        strategy.HandleBatch(addr + block_offset,
+                             std::span<uint64_t>(block_words, count), pointers,
+                             region.is_writable, region) &
+        valid;
+
+    if (modified != 0 && page_counts != nullptr) {
+      // Our own write is cleared along with the soft-dirty bits, so make sure
+      // the page is rescanned next time
+      page_counts[block_offset / page_size_] = kUncached;
+    }
+    for (; modified != 0; modified &= modified - 1) {
+      const auto word = static_cast<unsigned>(std::countr_zero(modified));
+      const size_t offset = block_offset + word * sizeof(uint64_t);
+      const uint64_t value = block_words[word];
+      // Write back only the modified word; chunks span many pages. The
+      // strategy was told whether the region is writable, and WriteMemory can
+      // reach read-only mappings through /proc/<pid>/mem
+      std::memcpy(data + offset, &value, sizeof(value));
+      if (deferred_writes != nullptr) {
+        deferred_writes->push_back({addr + offset, value});
+      } else {
+        WriteMemory(addr + offset, &value, sizeof(value));
+      }
+    }
+  }
+}
+
+template <typename Strategy>
+ProcessManager::ChunkKernel
+ProcessManager::SelectChunkKernel(unsigned callbacks) {
+  const bool pointers = callbacks & kPointerCallback;
+  const bool non_pointers = callbacks & kNonPointerCallback;
+  if (pointers && non_pointers) {
+    return &ProcessManager::ClassifyChunk<Strategy, true, true>;
+  }
+  if (pointers) {
+    return &ProcessManager::ClassifyChunk<Strategy, true, false>;
+  }
+  if (non_pointers) {
+    return &ProcessManager::ClassifyChunk<Strategy, false, true>;
+  }
+  return &ProcessManager::ClassifyChunk<Strategy, false, false>;
+}
+
+ProcessManager::ChunkKernel
+ProcessManager::SelectChunkKernel(InjectionStrategy &strategy) {
+  const unsigned callbacks = strategy.Callbacks();
+  if (dynamic_cast<ErrorInjectionStrategy *>(&strategy) != nullptr) {
+    return SelectChunkKernel<ErrorInjectionStrategy>(callbacks);
+  }
+  // Any other strategy goes through the vtable for the callbacks it wants
+  return SelectChunkKernel<InjectionStrategy>(callbacks);
+}
+
+void ScanStats::Merge(const ScanStats &other) {
+  total_bytes_scanned += other.total_bytes_scanned;
+  bytes_readable += other.bytes_readable;
+  bytes_writable += other.bytes_writable;
+  bytes_executable += other.bytes_executable;
+  bytes_skipped += other.bytes_skipped;
+  bytes_not_resident += other.bytes_not_resident;
+  bytes_reused += other.bytes_reused;
+  bytes_filtered += other.bytes_filtered;
+  pointers_found += other.pointers_found;
+  regions_scanned += other.regions_scanned;
+}
+
+std::ostream &operator<<(std::ostream &os, const ScanStats &stats) {
+  double percent =
+      100. * (sizeof(uintptr_t) * static_cast<double>(stats.pointers_found)) /
+      static_cast<double>(stats.bytes_readable - stats.bytes_executable);
+  os << "Scan Statistics:\n"
+     << std::dec << "  Regions scanned:         " << stats.regions_scanned
+     << "\n"
+     << "  Total bytes scanned:     " << stats.total_bytes_scanned << " ("
+     << (static_cast<double>(stats.total_bytes_scanned) / (1024.0 * 1024.0))
+     << " MB)\n"
      << "  Readable bytes:          " << stats.bytes_readable << " ("
      << (static_cast<double>(stats.bytes_readable) / (1024.0 * 1024.0))
      << " MB)\n"
@@ -587,10 +2937,55 @@ std::ostream &operator<<(std::ostream &os, const ScanStats &stats) {
      << "  Bytes skipped:           " << stats.bytes_skipped << " ("
      << (static_cast<double>(stats.bytes_skipped) / (1024.0 * 1024.0))
      << " MB)\n"
+     << "  Non-resident bytes:      " << stats.bytes_not_resident << " ("
+     << (static_cast<double>(stats.bytes_not_resident) / (1024.0 * 1024.0))
+     << " MB)\n"
+     << "  Reused (clean) bytes:    " << stats.bytes_reused << " ("
+     << (static_cast<double>(stats.bytes_reused) / (1024.0 * 1024.0))
+     << " MB)\n"
+     << "  Filtered bytes:          " << stats.bytes_filtered << " ("
+     << (static_cast<double>(stats.bytes_filtered) / (1024.0 * 1024.0))
+     << " MB)\n"
      << "  Pointers found:          " << stats.pointers_found << "\n"
      << "  Pointers as % of memory: " << std::setprecision(2) << percent
      << "%\n"
-     << "  Scan time:               " << stats.scan_time_ms << " ms";
+     << "  Scan time:               " << stats.scan_time_ms << " ms\n"
+     << "  Stop to first read:      " << std::fixed << std::setprecision(3)
+     << stats.stop_to_read_ms << " ms\n"
+     << "  Freeze time:             " << stats.freeze_ms << " ms ("
+     << stats.threads_stopped << " threads)";
+  if (stats.concurrent_ms > 0) {
+    os << std::fixed << std::setprecision(1)
+       << "\n  Concurrent pass:         " << stats.concurrent_ms << " ms ("
+       << (static_cast<double>(stats.concurrent_bytes) / (1024.0 * 1024.0))
+       << " MB)\n"
+       << "  Stopped for:             " << stats.stopped_ms << " ms ("
+       << 100. * (1. - stats.stopped_ms / stats.concurrent_ms)
+       << "% less than the concurrent pass)";
+  }
+  if (stats.snapshot) {
+    os << std::fixed << std::setprecision(1)
+       << "\n  Stopped for:             " << stats.stopped_ms
+       << " ms (fork snapshot)\n"
+       << "  Writes skipped:          " << stats.writes_skipped
+       << " (changed since the snapshot)";
+  }
+  if (stats.stopped_early) {
+    os << "\n  Stopped early:           strategy saturated";
+  }
+  if (!stats.thread_busy_ms.empty()) {
+    os << "\n  Thread busy/idle (ms):   " << std::fixed << std::setprecision(1);
+    for (size_t i = 0; i < stats.thread_busy_ms.size(); i++) {
+      os << (i > 0 ? ", " : "") << stats.thread_busy_ms[i] << "/"
+         << stats.thread_idle_ms[i];
+    }
+  }
+  if (stats.reader_occupancy > 0 || stats.classifier_occupancy > 0) {
+    os << "\n  Pipeline occupancy:      reader "
+       << 100. * stats.reader_occupancy << "%, classifier "
+       << 100. * stats.classifier_occupancy << "%, writer "
+       << 100. * stats.writer_occupancy << "%";
+  }
   return os;
 }
 
@@ -1,3 +1,4 @@
+#include "cgroup_freezer.hh"
 #include "cli.hh"
 #include "command_handler.hh"
 #include "monitor_controller.hh"
@@ -70,6 +71,12 @@ int main(int argc, char *argv[]) {
 
   try {
     app.parse(argc, argv);
+    // The freezer leaves nothing traced to inject the fork into
+    if (subcmds.run_periodic->parsed() && periodic_opts.snapshot &&
+        periodic_opts.stop_mode == StopMode::Freeze) {
+      throw CLI::ValidationError("--snapshot",
+                                 "cannot be used with --stop-mode freeze");
+    }
   } catch (const CLI::ParseError &e) {
     return app.exit(e);
   }
@@ -85,6 +92,19 @@ int main(int argc, char *argv[]) {
   setup_signal_handlers();
   SetupLogging(active_opts);
 
+  // The freezer stops a whole cgroup, so the target gets one of its own
+  std::string freeze_cgroup;
+  if (active_opts.stop_mode == StopMode::Freeze) {
+    auto cgroup =
+        CgroupFreezer::Create("memory_tools-" + std::to_string(getpid()));
+    if (!cgroup) {
+      spdlog::error("Failed to create a cgroup for the target: {}",
+                    strerror(errno));
+      return 1;
+    }
+    freeze_cgroup = *cgroup;
+  }
+
   pid_t child_pid = fork();
   if (child_pid == -1) {
     spdlog::error("Fork failed: {}", strerror(errno));
@@ -94,6 +114,14 @@ int main(int argc, char *argv[]) {
   if (child_pid == 0) {
     // Child process
 
+    // Joining before exec leaves no window for threads or children to be
+    // created outside the cgroup
+    if (!freeze_cgroup.empty() && !CgroupFreezer::Join(freeze_cgroup)) {
+      spdlog::error("Failed to join cgroup {}: {}", freeze_cgroup,
+                    strerror(errno));
+      exit(1);
+    }
+
     std::vector<char *> exec_args;
 
     // Convert all program arguments to char* for execvp
@@ -118,11 +146,16 @@ int main(int argc, char *argv[]) {
         std::chrono::milliseconds(periodic_opts.initial_delay_ms);
     config.iteration_limit = periodic_opts.max_iterations;
     config.interval = std::chrono::milliseconds(periodic_opts.interval_ms);
+    config.incremental = periodic_opts.incremental;
+    config.scan_method = periodic_opts.snapshot     ? ScanMethod::Snapshot
+                         : periodic_opts.concurrent ? ScanMethod::Concurrent
+                                                    : ScanMethod::Stopped;
   } else if (is_cmd) {
     mode = MonitorMode::Command;
   } else {
     exit(1);
   }
+  config.freeze_cgroup = freeze_cgroup;
 
   MonitorController controller(child_pid, active_opts, mode, config);
   controller.StartMonitoring();
@@ -132,6 +165,10 @@ int main(int argc, char *argv[]) {
   kill(child_pid, SIGKILL);
   waitpid(child_pid, nullptr, 0);
   spdlog::info("Child process terminated");
+  if (!freeze_cgroup.empty() && !CgroupFreezer::Remove(freeze_cgroup)) {
+    spdlog::warn("Failed to remove cgroup {}: {}", freeze_cgroup,
+                 strerror(errno));
+  }
   spdlog::info("Monitoring complete");
 
   return 0;
@@ -0,0 +1,129 @@
+#include "thread_pool.hh"
+#include "placement.hh"
+#include <algorithm>
+
+namespace memory_tools {
+
+ThreadPool::ThreadPool(size_t num_threads)
+    : queues_(std::max<size_t>(1, num_threads)), times_(queues_.size()) {
+  for (size_t worker = 0; worker < queues_.size(); worker++) {
+    workers_.emplace_back([this, worker]() { WorkerLoop(worker); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  start_cv_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+bool ThreadPool::Pin(const std::vector<int> &cpus) {
+  bool pinned = !cpus.empty();
+  for (size_t worker = 0; pinned && worker < workers_.size(); worker++) {
+    pinned = PinThread(workers_[worker].native_handle(),
+                       cpus[worker % cpus.size()]);
+  }
+  return pinned;
+}
+
+void ThreadPool::Run(size_t num_tasks, const Task &task) {
+  const size_t num_workers = workers_.size();
+  cancelled_.store(false, std::memory_order_relaxed);
+  for (size_t worker = 0; worker < num_workers; worker++) {
+    std::lock_guard<std::mutex> lock(queues_[worker].mutex);
+    for (size_t i = worker * num_tasks / num_workers;
+         i < (worker + 1) * num_tasks / num_workers; i++) {
+      queues_[worker].tasks.push_back(i);
+    }
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    task_ = &task;
+    finished_ = 0;
+    generation_++;
+    start_cv_.notify_all();
+    done_cv_.wait(lock, [&] { return finished_ == num_workers; });
+    task_ = nullptr;
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+
+  // A cancelled run leaves its remaining tasks behind
+  for (auto &queue : queues_) {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.clear();
+  }
+
+  for (auto &time : times_) {
+    time.idle =
+        std::max(std::chrono::nanoseconds{0},
+                 std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed) -
+                     time.busy);
+  }
+}
+
+void ThreadPool::WorkerLoop(size_t worker) {
+  uint64_t seen = 0;
+  for (;;) {
+    const Task *task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_cv_.wait(lock, [&] { return stop_ || generation_ != seen; });
+      if (stop_) {
+        return;
+      }
+      seen = generation_;
+      task = task_;
+    }
+
+    // No tasks are added during a run, so once every deque is empty this
+    // worker is done
+    std::chrono::nanoseconds busy{0};
+    size_t index;
+    while (!cancelled_.load(std::memory_order_relaxed) &&
+           (Pop(worker, index) || Steal(worker, index))) {
+      const auto start = std::chrono::steady_clock::now();
+      (*task)(worker, index);
+      busy += std::chrono::steady_clock::now() - start;
+    }
+    times_[worker].busy = busy;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      finished_++;
+    }
+    done_cv_.notify_one();
+  }
+}
+
+bool ThreadPool::Pop(size_t worker, size_t &task) {
+  auto &queue = queues_[worker];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.tasks.empty()) {
+    return false;
+  }
+  task = queue.tasks.front();
+  queue.tasks.pop_front();
+  return true;
+}
+
+bool ThreadPool::Steal(size_t worker, size_t &task) {
+  for (size_t i = 1; i < queues_.size(); i++) {
+    auto &queue = queues_[(worker + i) % queues_.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      task = queue.tasks.back();
+      queue.tasks.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace memory_tools
@@ -0,0 +1,114 @@
+#include "word_classifier.hh"
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace memory_tools {
+
+namespace {
+using Kernel = uint64_t (*)(const uint8_t *data);
+
+// Bits that are all zero or all one in a canonical user or kernel address
+constexpr long long kHighMask = static_cast<long long>(0xffff000000000000);
+
+bool IsCandidate(uint64_t value) {
+  const uint64_t high_bits = value >> 48;
+  return value != 0 && !(value & 0x1) &&
+         (high_bits == 0 || high_bits == 0xffff);
+}
+
+uint64_t ScalarMask(const uint8_t *data, size_t words) {
+  uint64_t mask = 0;
+  for (size_t i = 0; i < words; i++) {
+    uint64_t value;
+    std::memcpy(&value, data + i * sizeof(uint64_t), sizeof(uint64_t));
+    mask |= static_cast<uint64_t>(IsCandidate(value)) << i;
+  }
+  return mask;
+}
+
+uint64_t ScalarKernel(const uint8_t *data) {
+  return ScalarMask(data, kClassifyBlockWords);
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2"))) uint64_t Avx2Kernel(const uint8_t *data) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i one = _mm256_set1_epi64x(1);
+  const __m256i high_mask = _mm256_set1_epi64x(kHighMask);
+
+  uint64_t mask = 0;
+  for (size_t i = 0; i < kClassifyBlockWords; i += 4) {
+    const __m256i value = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(data + i * sizeof(uint64_t)));
+    const __m256i high_bits = _mm256_and_si256(value, high_mask);
+    const __m256i canonical =
+        _mm256_or_si256(_mm256_cmpeq_epi64(high_bits, zero),
+                        _mm256_cmpeq_epi64(high_bits, high_mask));
+    const __m256i aligned =
+        _mm256_cmpeq_epi64(_mm256_and_si256(value, one), zero);
+    // andnot(a, b) is ~a & b, which drops the zero words
+    const __m256i candidate = _mm256_andnot_si256(
+        _mm256_cmpeq_epi64(value, zero), _mm256_and_si256(canonical, aligned));
+    const int lanes = _mm256_movemask_pd(_mm256_castsi256_pd(candidate));
+    mask |= static_cast<uint64_t>(static_cast<unsigned>(lanes)) << i;
+  }
+  return mask;
+}
+
+__attribute__((target("avx512f"))) uint64_t
+Avx512Kernel(const uint8_t *data) {
+  const __m512i zero = _mm512_setzero_si512();
+  const __m512i one = _mm512_set1_epi64(1);
+  const __m512i high_mask = _mm512_set1_epi64(kHighMask);
+
+  uint64_t mask = 0;
+  for (size_t i = 0; i < kClassifyBlockWords; i += 8) {
+    const __m512i value = _mm512_loadu_si512(data + i * sizeof(uint64_t));
+    const __m512i high_bits = _mm512_and_si512(value, high_mask);
+    const __mmask8 canonical = _mm512_cmpeq_epi64_mask(high_bits, zero) |
+                               _mm512_cmpeq_epi64_mask(high_bits, high_mask);
+    const __mmask8 aligned = _mm512_testn_epi64_mask(value, one);
+    const __mmask8 non_zero = _mm512_test_epi64_mask(value, value);
+    mask |= static_cast<uint64_t>(canonical & aligned & non_zero) << i;
+  }
+  return mask;
+}
+#endif
+
+struct Selection {
+  Kernel kernel;
+  const char *name;
+};
+
+Selection SelectKernel() {
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return {Avx512Kernel, "avx512"};
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return {Avx2Kernel, "avx2"};
+  }
+#endif
+  return {ScalarKernel, "scalar"};
+}
+
+const Selection &Selected() {
+  static const Selection selection = SelectKernel();
+  return selection;
+}
+} // namespace
+
+uint64_t CandidateMask(const uint8_t *data, size_t words) {
+  if (words == kClassifyBlockWords) {
+    return Selected().kernel(data);
+  }
+  return ScalarMask(data, words);
+}
+
+const char *ClassifierKernelName() { return Selected().name; }
+
+} // namespace memory_tools